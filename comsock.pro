@@ -11,18 +11,50 @@ SOURCES += \
     src/ui/main_win.cpp \
     src/core/client.cpp \
     src/core/message.cpp \
+    src/core/filter.cpp \
+    src/core/nick_index.cpp \
+    src/core/state.cpp \
+    src/core/dcc.cpp \
+    src/core/plugins.cpp \
+    src/core/scrollback.cpp \
+    src/core/history.cpp \
+    src/core/protocol.cpp \
+    src/core/core_server.cpp \
+    src/core/core_link.cpp \
+    src/core/log_import.cpp \
     src/ui/dialogs/connect.cpp \
     src/ui/widgets/chan_list.cpp \
     src/ui/widgets/usr_list.cpp \
     src/ui/widgets/msg_display.cpp \
+    src/ui/widgets/mono_view.cpp \
+    src/ui/widgets/input_line.cpp \
+    src/ui/widgets/transfer_list.cpp \
     src/utils/color.cpp
 
 HEADERS += \
     src/core/client.h \
     src/core/message.h \
+    src/core/filter.h \
+    src/core/nick_index.h \
+    src/core/state.h \
+    src/core/dcc.h \
+    src/core/plugin.h \
+    src/core/plugins.h \
+    src/core/scrollback.h \
+    src/core/history.h \
+    src/core/session.h \
+    src/core/protocol.h \
+    src/core/core_server.h \
+    src/core/core_link.h \
+    src/core/log_import.h \
     src/ui/dialogs/connect.h \
     src/ui/widgets/chan_list.h \
     src/ui/widgets/usr_list.h \
     src/ui/widgets/msg_display.h \
+    src/ui/widgets/mono_view.h \
+    src/ui/widgets/input_line.h \
+    src/ui/widgets/transfer_list.h \
     src/ui/main_win.h \
     src/utils/color.h
+
+RESOURCES += comsock.qrc
\ No newline at end of file
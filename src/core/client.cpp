@@ -3,11 +3,27 @@
 #include <QTimer>
 #include <QRandomGenerator>
 
-IrcClient::IrcClient(QObject* parent) : QObject(parent), socket(new QTcpSocket(this)) {
+IrcClient::IrcClient(QObject* parent)
+    : Session(parent), socket(new QTcpSocket(this)), pluginManager(new PluginManager(this, this)),
+      logImporter(new LogImporter(&imported, this)) {
     connect(socket, &QTcpSocket::readyRead, this, &IrcClient::handleSocketData);
     connect(socket, &QTcpSocket::connected, this, &IrcClient::handleConnected);
-    connect(socket, &QTcpSocket::disconnected, this, &IrcClient::disconnected);
+    connect(socket, &QTcpSocket::disconnected, this, [this]() {
+        registered = false;
+        ircState.clear();
+        emit disconnected();
+    });
     connect(socket, &QTcpSocket::errorOccurred, this, &IrcClient::handleError);
+    
+    // Imported lines are written to history as they are parsed, never displayed
+    connect(logImporter, &LogImporter::progress, this, &IrcClient::importProgress);
+    connect(logImporter, &LogImporter::finished, this, [this](qint64 count, const QString& error) {
+        if (count > 0) {
+            importRevision++;
+            emit historyChanged();
+        }
+        emit importFinished(count, error);
+    });
 }
 
 void IrcClient::connectToServer(const QString& host, quint16 port) {
@@ -23,12 +39,13 @@ void IrcClient::connectToServer(const QString& host, quint16 port) {
     }
 
     // Send registration exactly like ComSock does
-    QString cmd = QString("NICK %1\r\nUSER %2 0 * :My IRC Client\r\n")
-                 .arg(currentNickname)
-                 .arg(currentUsername.isEmpty() ? currentNickname : currentUsername);
+    QString nickCmd = QString("NICK %1").arg(currentNickname);
+    QString userCmd = QString("USER %1 0 * :My IRC Client")
+                     .arg(currentUsername.isEmpty() ? currentNickname : currentUsername);
     
-    qDebug() << "Sending registration:" << cmd.trimmed();
-    socket->write(cmd.toUtf8());
+    qDebug() << "Sending registration:" << nickCmd << userCmd;
+    sendRaw(nickCmd);
+    sendRaw(userCmd);
     socket->flush();
 }
 
@@ -43,8 +60,28 @@ void IrcClient::sendMessage(const QString& channel, const QString& message) {
         qDebug() << "Cannot send message: not connected";
         return;
     }
-    QString cmd = QString("PRIVMSG %1 :%2\r\n").arg(channel, message);
-    socket->write(cmd.toUtf8());
+    sendRaw(QString("PRIVMSG %1 :%2").arg(channel, message));
+    
+    // Our own lines go into scrollback too, except for CTCP requests
+    if (message.startsWith("\x01" "ACTION ")) {
+        record(channel, ScrollbackLine::Action, currentNickname, message.mid(8).remove('\x01'));
+    } else if (!message.startsWith('\x01')) {
+        record(channel, ScrollbackLine::Message, currentNickname, message);
+    }
+}
+
+void IrcClient::sendRaw(const QString& line) {
+    if (!pluginManager->dispatchOutgoing(line)) {
+        qDebug() << "Plugin suppressed:" << line;
+        return;
+    }
+    socket->write((line + "\r\n").toUtf8());
+}
+
+void IrcClient::importLogs(const QStringList& paths) {
+    if (!logImporter->start(paths)) {
+        emit importFinished(0, "An import is already running.");
+    }
 }
 
 void IrcClient::joinChannel(const QString& channel) {
@@ -52,16 +89,14 @@ void IrcClient::joinChannel(const QString& channel) {
         qDebug() << "Cannot join channel: not connected";
         return;
     }
-    QString cmd = QString("JOIN %1\r\n").arg(channel);
-    socket->write(cmd.toUtf8());
+    sendRaw(QString("JOIN %1").arg(channel));
 }
 
 void IrcClient::setNickname(const QString& nickname) {
     currentNickname = nickname;
     if (socket && socket->state() == QTcpSocket::ConnectedState) {
         qDebug() << "Setting nickname:" << nickname;
-        QString cmd = QString("NICK %1\r\n").arg(nickname);
-        socket->write(cmd.toUtf8());
+        sendRaw(QString("NICK %1").arg(nickname));
     }
 }
 
@@ -69,8 +104,7 @@ void IrcClient::setUsername(const QString& username) {
     currentUsername = username;
     if (socket && socket->state() == QTcpSocket::ConnectedState) {
         qDebug() << "Setting username:" << username;
-        QString cmd = QString("USER %1 0 * :%1\r\n").arg(username);
-        socket->write(cmd.toUtf8());
+        sendRaw(QString("USER %1 0 * :%1").arg(username));
     }
 }
 
@@ -95,32 +129,146 @@ void IrcClient::handleSocketData() {
         line = line.trimmed();
         qDebug() << "Received:" << line;
         
-        // Match ComSock's PING handling exactly
+        // Match ComSock's PING handling exactly. Plugins see the PING but
+        // cannot drop it, or a hook returning false would time us out
         if (line.startsWith("PING")) {
-            QString response = QString("PONG %1\r\n").arg(line.mid(5));
-            qDebug() << "Sending:" << response.trimmed();
-            socket->write(response.toUtf8());
+            pluginManager->dispatchIncoming(IrcMessage::parse(line));
+            QString response = QString("PONG %1").arg(line.mid(5));
+            qDebug() << "Sending:" << response;
+            sendRaw(response);
             socket->flush();
             continue;
         }
         
         IrcMessage msg = IrcMessage::parse(line);
         
+        // Plugins see the parsed message first and may drop it entirely
+        if (!pluginManager->dispatchIncoming(msg)) continue;
+        
         if (msg.command == "001") {  // RPL_WELCOME
             qDebug() << "Registration successful!";
+            currentNickname = msg.params.section(' ', 0, 0);
+            ircState.setSelf(currentNickname);
+            registered = true;
+            record(QString(), ScrollbackLine::System, QString(), msg.trailing);
             emit connected();
         }
-        else if (msg.command == "PRIVMSG") {
+        else if (msg.command == "005") {  // RPL_ISUPPORT
+            ircState.applyIsupport(msg.params.split(' ', Qt::SkipEmptyParts).mid(1));
+            record(QString(), ScrollbackLine::System, QString(), msg.trailing);
             emit messageReceived(msg);
         }
+        else if (msg.command == "PRIVMSG" || msg.command == "NOTICE") {
+            // Ignored lines stop here, before they ever reach the UI
+            MessageFilter::Verdict verdict = messageFilter.apply(msg);
+            if (verdict == MessageFilter::Ignore) continue;
+            msg.highlighted = verdict == MessageFilter::Highlight;
+            
+            // DCC offers go to the transfer manager; other CTCPs display as before
+            if (msg.command == "PRIVMSG" && msg.trailing.startsWith("\x01" "DCC ")) {
+                QString ctcp = msg.trailing.mid(1);
+                if (ctcp.endsWith('\x01')) ctcp.chop(1);
+                emit ctcpReceived(msg.nickname(), ctcp);
+                continue;
+            }
+            emit messageReceived(msg);
+            
+            // Channel traffic goes to the channel, queries to the sender
+            QString target = msg.params.section(' ', 0, 0);
+            bool toChannel = !target.isEmpty() && QString("#&+!").contains(target.at(0));
+            if (msg.command == "NOTICE") {
+                record(toChannel ? target : QString(), ScrollbackLine::Notice,
+                       msg.nickname(), msg.trailing, msg.highlighted);
+            } else {
+                QString buffer = toChannel ? target : msg.nickname();
+                if (msg.trailing.startsWith("\x01" "ACTION")) {
+                    QString action = msg.trailing.mid(8);
+                    action.remove('\x01');
+                    record(buffer, ScrollbackLine::Action, msg.nickname(), action, msg.highlighted);
+                } else {
+                    record(buffer, ScrollbackLine::Message, msg.nickname(), msg.trailing, msg.highlighted);
+                }
+            }
+        }
         else if (msg.command == "JOIN") {
-            emit userJoined(msg.params, msg.nickname());
+            QString channel = msg.params.isEmpty() ? msg.trailing : msg.params.section(' ', 0, 0);
+            ircState.join(channel, msg.prefix);
+            // Announce the join before its line so attached front-ends have the tab first
+            emit userJoined(channel, msg.nickname());
+            record(channel, ScrollbackLine::System, msg.nickname(),
+                   QString("%1 has joined %2").arg(msg.nickname(), channel));
+        }
+        else if (msg.command == "PART") {
+            ircState.part(msg.params, msg.nickname());
+            record(msg.params, ScrollbackLine::System, msg.nickname(),
+                   QString("%1 has left %2").arg(msg.nickname(), msg.params));
+            emit userLeft(msg.params, msg.nickname());
+        }
+        else if (msg.command == "KICK") {
+            QString channel = msg.params.section(' ', 0, 0);
+            QString victim = msg.params.section(' ', 1, 1);
+            ircState.part(channel, victim);
+            record(channel, ScrollbackLine::System, victim,
+                   QString("%1 was kicked by %2 (%3)").arg(victim, msg.nickname(), msg.trailing));
+            emit userLeft(channel, victim);
+        }
+        else if (msg.command == "QUIT") {
+            QStringList channels = ircState.quit(msg.nickname());
+            for (const QString& channel : channels) {
+                record(channel, ScrollbackLine::System, msg.nickname(),
+                       QString("%1 has quit (%2)").arg(msg.nickname(), msg.trailing));
+            }
+            emit userQuit(msg.nickname(), channels, msg.trailing);
+        }
+        else if (msg.command == "NICK") {
+            QString newNick = msg.trailing.isEmpty() ? msg.params : msg.trailing;
+            if (msg.nickname() == currentNickname) currentNickname = newNick;
+            QStringList channels = ircState.rename(msg.nickname(), newNick);
+            for (const QString& channel : channels) {
+                record(channel, ScrollbackLine::System, newNick,
+                       QString("%1 is now known as %2").arg(msg.nickname(), newNick));
+            }
+            emit nickChanged(msg.nickname(), newNick, channels);
+        }
+        else if (msg.command == "MODE") {
+            QStringList args = msg.params.split(' ', Qt::SkipEmptyParts);
+            if (!msg.trailing.isEmpty()) args << msg.trailing;
+            if (args.size() >= 2 && ircState.channel(args[0])) {
+                ircState.applyMode(args[0], args[1], args.mid(2));
+                record(args[0], ScrollbackLine::System, msg.nickname(),
+                       QString("%1 sets mode %2").arg(msg.nickname(), args.mid(1).join(' ')));
+                emit channelModesChanged(args[0], args[1], args.mid(2));
+            }
+        }
+        else if (msg.command == "TOPIC" || msg.command == "332") {  // RPL_TOPIC
+            QString channel = msg.params.section(' ', -1);
+            ircState.setTopic(channel, msg.trailing);
+            record(channel, ScrollbackLine::System, msg.nickname(),
+                   QString("Topic for %1: %2").arg(channel, msg.trailing));
+            emit topicChanged(channel, msg.trailing);
+        }
+        else if (msg.command == "AWAY") {
+            ircState.setAway(msg.nickname(), !msg.trailing.isEmpty());
+            emit awayChanged(msg.nickname(), !msg.trailing.isEmpty());
+        }
+        else if (msg.command == "ACCOUNT") {
+            ircState.setAccount(msg.nickname(), msg.params);
+            emit accountChanged(msg.nickname(), msg.params);
+        }
+        else if (msg.command == "353") {  // RPL_NAMREPLY
+            QString channel = msg.params.section(' ', -1);
+            ircState.addNames(channel, msg.trailing.split(' ', Qt::SkipEmptyParts));
+        }
+        else if (msg.command == "366") {  // RPL_ENDOFNAMES
+            emit namesReceived(msg.params.section(' ', 1, 1));
         }
         else if (msg.command == "ERROR") {
             qDebug() << "Server error:" << msg.trailing;
+            record(QString(), ScrollbackLine::System, QString(), QString("ERROR: %1").arg(msg.trailing));
             emit error(msg.trailing);
         }
-        else if (msg.command.toInt() > 0 || msg.command == "NOTICE") {
+        else if (msg.command.toInt() > 0) {
+            record(QString(), ScrollbackLine::System, QString(), msg.trailing);
             emit messageReceived(msg);
         }
     }
@@ -130,20 +278,33 @@ void IrcClient::sendRegistration() {
     qDebug() << "Sending registration...";
     
     // Send NICK first
-    QString nickCmd = QString("NICK %1\r\n").arg(currentNickname);
-    qDebug() << "Sending:" << nickCmd.trimmed();
-    socket->write(nickCmd.toUtf8());
+    QString nickCmd = QString("NICK %1").arg(currentNickname);
+    qDebug() << "Sending:" << nickCmd;
+    sendRaw(nickCmd);
     socket->flush();
     
     // Send USER command
-    QString userCmd = QString("USER %1 0 * :%1\r\n").arg(currentUsername);
-    qDebug() << "Sending:" << userCmd.trimmed();
-    socket->write(userCmd.toUtf8());
+    QString userCmd = QString("USER %1 0 * :%1").arg(currentUsername);
+    qDebug() << "Sending:" << userCmd;
+    sendRaw(userCmd);
     socket->flush();
     
     registrationSent = true;
 }
 
+void IrcClient::record(const QString& buffer, ScrollbackLine::Kind kind, const QString& nick,
+                       const QString& text, bool highlighted) {
+    ScrollbackLine line;
+    line.timestamp = QDateTime::currentDateTime();
+    line.buffer = buffer;
+    line.nick = nick;
+    line.text = text;
+    line.kind = kind;
+    line.highlighted = highlighted;
+    line.seq = lines.append(line);
+    emit lineAdded(line);
+}
+
 void IrcClient::reconnect() {
     socket->disconnectFromHost();
     if (socket->state() != QAbstractSocket::UnconnectedState) {
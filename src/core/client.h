@@ -2,28 +2,48 @@
 #include <QObject>
 #include <QTcpSocket>
 #include "message.h"
+#include "filter.h"
+#include "state.h"
+#include "plugins.h"
+#include "scrollback.h"
+#include "history.h"
+#include "log_import.h"
+#include "session.h"
 
-class IrcClient : public QObject {
+class IrcClient : public Session {
     Q_OBJECT
 public:
     explicit IrcClient(QObject* parent = nullptr);
     
-    void connectToServer(const QString& host, quint16 port = 6667);
-    void disconnect();
-    void sendMessage(const QString& channel, const QString& message);
-    void joinChannel(const QString& channel);
-    void setNickname(const QString& nickname);
-    void setUsername(const QString& username);
-    QString nickname() const { return currentNickname; }
+    void connectToServer(const QString& host, quint16 port = 6667) override;
+    void disconnect() override;
+    void sendRaw(const QString& line) override;
+    void sendMessage(const QString& channel, const QString& message) override;
+    void joinChannel(const QString& channel) override;
+    void setNickname(const QString& nickname) override;
+    void setUsername(const QString& username) override;
+    QString nickname() const override { return currentNickname; }
+    bool isConnected() const override { return registered; }
+    QHostAddress localAddress() const override { return socket->localAddress(); }
+    const IrcState* state() const override { return &ircState; }
+    const Scrollback* scrollback() const override { return &lines; }
+    const History* history() const override { return &imported; }
+    
+    QStringList ignoreRules() const override { return messageFilter.ignoreRules(); }
+    QStringList highlightRules() const override { return messageFilter.highlightRules(); }
+    void setIgnoreRules(const QStringList& rules) override { messageFilter.setIgnoreRules(rules); }
+    void setHighlightRules(const QStringList& rules) override { messageFilter.setHighlightRules(rules); }
+    QString pluginReport() const override { return pluginManager->report(); }
+    void importLogs(const QStringList& paths) override;
+    void cancelImport() override { logImporter->cancel(); }
+    
+    MessageFilter* filter() { return &messageFilter; }
+    PluginManager* plugins() { return pluginManager; }
+    Scrollback* scrollback() { return &lines; }
+    quint64 historyRevision() const { return importRevision; }
     
 signals:
-    void connected();
-    void disconnected();
     void messageReceived(const IrcMessage& message);
-    void userJoined(const QString& channel, const QString& nickname);
-    void userLeft(const QString& channel, const QString& nickname);
-    void topicChanged(const QString& channel, const QString& topic);
-    void error(const QString& error);
     
 private slots:
     void handleConnected();
@@ -35,9 +55,19 @@ private:
     QString currentNickname;
     QString currentUsername;
     bool registrationSent = false;
+    bool registered = false;
+    MessageFilter messageFilter;
+    IrcState ircState;
+    Scrollback lines;
+    History imported;
+    quint64 importRevision = 0;     // bumped whenever an import added history
+    PluginManager* pluginManager;
+    LogImporter* logImporter;
     
     // Helper methods
     void sendRegistration();
     void sendUserCommand();
     void reconnect();
+    void record(const QString& buffer, ScrollbackLine::Kind kind, const QString& nick,
+                const QString& text, bool highlighted = false);
 };
\ No newline at end of file
@@ -0,0 +1,316 @@
+#include "core_link.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+CoreLink::CoreLink(QObject* parent)
+    : Session(parent), socket(new QLocalSocket(this)), retryTimer(new QTimer(this)) {
+    connect(socket, &QLocalSocket::readyRead, this, &CoreLink::handleReadyRead);
+    connect(socket, &QLocalSocket::disconnected, this, &CoreLink::handleDisconnected);
+    retryTimer->setInterval(1000);
+    connect(retryTimer, &QTimer::timeout, this, &CoreLink::reattach);
+}
+
+bool CoreLink::attach(const QString& name, int timeout) {
+    serverName = name;
+    socket->connectToServer(name);
+    if (!socket->waitForConnected(timeout)) {
+        socket->abort();
+        return false;
+    }
+
+    sendHello();
+    QElapsedTimer timer;
+    timer.start();
+    while (!synced && timer.elapsed() < timeout) {
+        if (!socket->waitForReadyRead(int(timeout - timer.elapsed()))) break;
+    }
+    if (!synced) {
+        qWarning() << "Core did not answer on" << name;
+        socket->abort();
+        return false;
+    }
+    attached = true;
+    qDebug() << "Attached to core on" << socket->fullServerName();
+    return true;
+}
+
+void CoreLink::connectToServer(const QString& host, quint16 port) {
+    sendCommand("connect", {host, QString::number(port)});
+}
+
+void CoreLink::disconnect() {
+    sendCommand("disconnect");
+}
+
+void CoreLink::sendRaw(const QString& line) {
+    sendCommand("raw", {line});
+}
+
+void CoreLink::sendMessage(const QString& channel, const QString& message) {
+    sendCommand("message", {channel, message});
+}
+
+void CoreLink::joinChannel(const QString& channel) {
+    sendCommand("join", {channel});
+}
+
+void CoreLink::setNickname(const QString& nickname) {
+    if (!serverConnected) currentNickname = nickname;
+    sendCommand("nick", {nickname});
+}
+
+void CoreLink::setUsername(const QString& username) {
+    sendCommand("user", {username});
+}
+
+void CoreLink::setIgnoreRules(const QStringList& rules) {
+    ignore = rules;
+    sendCommand("ignore", rules);
+}
+
+void CoreLink::setHighlightRules(const QStringList& rules) {
+    highlight = rules;
+    sendCommand("highlight", rules);
+}
+
+void CoreLink::importLogs(const QStringList& paths) {
+    // The core reads the files, which is fine since it runs on this machine
+    QStringList absolute;
+    for (const QString& path : paths) absolute << QFileInfo(path).absoluteFilePath();
+    sendCommand("import", absolute);
+}
+
+void CoreLink::cancelImport() {
+    sendCommand("cancelImport");
+}
+
+void CoreLink::handleReadyRead() {
+    buffer.append(socket->readAll());
+    CoreProtocol::Type type;
+    QByteArray payload;
+    while (CoreProtocol::takeFrame(buffer, type, payload)) {
+        handleFrame(type, payload);
+    }
+}
+
+void CoreLink::handleDisconnected() {
+    // Keep retrying even when a reattach dropped before it finished syncing
+    if (!attached) return;
+    bool wasSynced = synced;
+    synced = false;
+    snapshotSeen = false;
+    buffer.clear();
+    retryTimer->start();
+    if (wasSynced) {
+        qWarning() << "Lost the core, retrying";
+        emit error("Detached from core.");
+    }
+}
+
+void CoreLink::reattach() {
+    if (socket->state() != QLocalSocket::UnconnectedState) return;
+    socket->connectToServer(serverName);
+    if (!socket->waitForConnected(500)) {
+        socket->abort();
+        return;
+    }
+    retryTimer->stop();
+    restoring = true;
+    sendHello();
+}
+
+void CoreLink::sendHello() {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << CoreProtocol::Version << instanceId << lines.lastSeq();
+    CoreProtocol::writeFrame(socket, CoreProtocol::Hello, payload);
+}
+
+void CoreLink::sendCommand(const QString& kind, const QStringList& args) {
+    if (socket->state() != QLocalSocket::ConnectedState) {
+        qDebug() << "Cannot send" << kind << ": not attached to a core";
+        return;
+    }
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << kind << args;
+    CoreProtocol::writeFrame(socket, CoreProtocol::Command, payload);
+}
+
+void CoreLink::handleFrame(CoreProtocol::Type type, const QByteArray& payload) {
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    if (type == CoreProtocol::Snapshot) {
+        applySnapshot(in);
+        snapshotSeen = true;
+    } else if (type == CoreProtocol::Lines && snapshotSeen) {
+        // Anything sent before the snapshot is part of the delta that follows it
+        applyLines(in);
+        if (!synced) {
+            // The first Lines frame after the snapshot completes the sync
+            synced = true;
+            if (restoring) {
+                restoring = false;
+                emit sessionRestored();
+            }
+            if (historyStale) {
+                historyStale = false;
+                emit historyChanged();
+            }
+        }
+    } else if (type == CoreProtocol::Event && synced) {
+        QString kind;
+        QStringList args;
+        in >> kind >> args;
+        applyEvent(kind, args);
+    }
+}
+
+void CoreLink::applySnapshot(QDataStream& in) {
+    quint64 instance = 0;
+    QString addressText;
+    QStringList isupport;
+    quint64 revision = 0;
+    in >> instance >> currentNickname >> serverConnected >> addressText
+       >> ignore >> highlight >> plugins >> isupport >> revision;
+
+    // A restarted core numbers its lines from scratch
+    if (instance != instanceId) lines.clear();
+    instanceId = instance;
+    address = QHostAddress(addressText);
+
+    // Imported lines never travel as scrollback, so a reattach has to be
+    // told to reload them when an import finished while it was away
+    if (revision != historyRevision) historyStale = true;
+    historyRevision = revision;
+
+    ircState.clear();
+    ircState.setSelf(currentNickname);
+    ircState.applyIsupport(isupport);
+
+    struct UserRow { QString prefix; QString account; bool away; };
+    quint32 userCount = 0;
+    in >> userCount;
+    QVector<UserRow> users;
+    users.reserve(userCount);
+    for (quint32 i = 0; i < userCount && !in.atEnd(); i++) {
+        QString nick, user, host, account;
+        bool away = false;
+        in >> nick >> user >> host >> account >> away;
+        QString prefix = user.isEmpty() && host.isEmpty() ? nick : QString("%1!%2@%3").arg(nick, user, host);
+        users.append({prefix, account, away});
+    }
+
+    quint32 channelCount = 0;
+    in >> channelCount;
+    for (quint32 i = 0; i < channelCount && !in.atEnd(); i++) {
+        QString name, topic;
+        quint32 memberCount = 0;
+        in >> name >> topic >> memberCount;
+
+        QStringList entries;
+        entries.reserve(memberCount);
+        for (quint32 j = 0; j < memberCount; j++) {
+            quint32 index = 0;
+            QString modes;
+            in >> index >> modes;
+            if (index < quint32(users.size())) entries << modes + users.at(index).prefix;
+        }
+        ircState.addNames(name, entries);
+        ircState.setTopic(name, topic);
+    }
+
+    for (const UserRow& row : qAsConst(users)) {
+        QString nick = row.prefix.section('!', 0, 0);
+        ircState.setAway(nick, row.away);
+        if (!row.account.isEmpty()) ircState.setAccount(nick, row.account);
+    }
+}
+
+void CoreLink::applyLines(QDataStream& in) {
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && !in.atEnd(); i++) {
+        ScrollbackLine line;
+        in >> line;
+        lines.insert(line);
+        emit lineAdded(line);
+    }
+}
+
+void CoreLink::applyEvent(const QString& kind, const QStringList& args) {
+    if (kind == "connected") {
+        currentNickname = args.value(0);
+        address = QHostAddress(args.value(1));
+        serverConnected = true;
+        ircState.setSelf(currentNickname);
+        emit connected();
+    }
+    else if (kind == "disconnected") {
+        serverConnected = false;
+        ircState.clear();
+        emit disconnected();
+    }
+    else if (kind == "isupport") {
+        ircState.applyIsupport(args);
+    }
+    else if (kind == "away") {
+        bool away = args.value(1) == "1";
+        ircState.setAway(args.value(0), away);
+        emit awayChanged(args.value(0), away);
+    }
+    else if (kind == "account") {
+        ircState.setAccount(args.value(0), args.value(1));
+        emit accountChanged(args.value(0), args.value(1));
+    }
+    else if (kind == "join") {
+        QString channel = args.value(0);
+        ircState.join(channel, args.value(1));
+        emit userJoined(channel, args.value(1).section('!', 0, 0));
+    }
+    else if (kind == "part") {
+        ircState.part(args.value(0), args.value(1));
+        emit userLeft(args.value(0), args.value(1));
+    }
+    else if (kind == "quit") {
+        ircState.quit(args.value(0));
+        emit userQuit(args.value(0), args.mid(2), args.value(1));
+    }
+    else if (kind == "nick") {
+        if (args.value(0) == currentNickname) currentNickname = args.value(1);
+        ircState.rename(args.value(0), args.value(1));
+        emit nickChanged(args.value(0), args.value(1), args.mid(2));
+    }
+    else if (kind == "mode") {
+        ircState.applyMode(args.value(0), args.value(1), args.mid(2));
+        emit channelModesChanged(args.value(0), args.value(1), args.mid(2));
+    }
+    else if (kind == "names") {
+        ircState.addNames(args.value(0), args.mid(1));
+        emit namesReceived(args.value(0));
+    }
+    else if (kind == "topic") {
+        ircState.setTopic(args.value(0), args.value(1));
+        emit topicChanged(args.value(0), args.value(1));
+    }
+    else if (kind == "ctcp") {
+        emit ctcpReceived(args.value(0), args.value(1));
+    }
+    else if (kind == "error") {
+        emit error(args.value(0));
+    }
+    else if (kind == "importProgress") {
+        emit importProgress(args.value(0).toLongLong(), args.value(1).toLongLong());
+    }
+    else if (kind == "history") {
+        historyRevision = args.value(0).toULongLong();
+        emit historyChanged();
+    }
+    else if (kind == "importFinished") {
+        emit importFinished(args.value(0).toLongLong(), args.value(1));
+    }
+}
\ No newline at end of file
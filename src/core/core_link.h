@@ -0,0 +1,74 @@
+#pragma once
+#include <QLocalSocket>
+#include <QTimer>
+#include "protocol.h"
+#include "session.h"
+
+// Front-end side of an attachment to a headless core. Keeps a replica of
+// the core's state and scrollback and forwards every action to the core.
+class CoreLink : public Session {
+    Q_OBJECT
+public:
+    explicit CoreLink(QObject* parent = nullptr);
+
+    // Blocks until the initial snapshot has arrived or timeout runs out
+    bool attach(const QString& name = CoreProtocol::socketName(), int timeout = 3000);
+
+    void connectToServer(const QString& host, quint16 port = 6667) override;
+    void disconnect() override;
+    void sendRaw(const QString& line) override;
+    void sendMessage(const QString& channel, const QString& message) override;
+    void joinChannel(const QString& channel) override;
+    void setNickname(const QString& nickname) override;
+    void setUsername(const QString& username) override;
+    QString nickname() const override { return currentNickname; }
+    bool isConnected() const override { return serverConnected; }
+    QHostAddress localAddress() const override { return address; }
+    const IrcState* state() const override { return &ircState; }
+    const Scrollback* scrollback() const override { return &lines; }
+    // The core runs on this machine, so its history files are read directly
+    const History* history() const override { return &imported; }
+
+    QStringList ignoreRules() const override { return ignore; }
+    QStringList highlightRules() const override { return highlight; }
+    void setIgnoreRules(const QStringList& rules) override;
+    void setHighlightRules(const QStringList& rules) override;
+    QString pluginReport() const override { return plugins; }
+    void importLogs(const QStringList& paths) override;
+    void cancelImport() override;
+
+private slots:
+    void handleReadyRead();
+    void handleDisconnected();
+    void reattach();
+
+private:
+    QLocalSocket* socket;
+    QTimer* retryTimer;
+    QString serverName;
+    QByteArray buffer;
+    bool attached = false;      // set once the first attach succeeded
+    bool synced = false;
+    bool snapshotSeen = false;
+    bool restoring = false;
+    bool historyStale = false;  // an import happened while detached
+
+    quint64 instanceId = 0;
+    QString currentNickname;
+    bool serverConnected = false;
+    QHostAddress address;
+    QStringList ignore;
+    QStringList highlight;
+    QString plugins;
+    IrcState ircState;
+    Scrollback lines;
+    History imported;
+    quint64 historyRevision = 0;
+
+    void sendHello();
+    void sendCommand(const QString& kind, const QStringList& args = QStringList());
+    void handleFrame(CoreProtocol::Type type, const QByteArray& payload);
+    void applySnapshot(QDataStream& in);
+    void applyLines(QDataStream& in);
+    void applyEvent(const QString& kind, const QStringList& args);
+};
\ No newline at end of file
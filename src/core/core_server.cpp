@@ -0,0 +1,268 @@
+#include "core_server.h"
+#include "client.h"
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+
+namespace {
+
+QString fullPrefix(const IrcUser* user) {
+    if (user->user.isEmpty() && user->host.isEmpty()) return user->nick;
+    return QString("%1!%2@%3").arg(user->nick, user->user, user->host);
+}
+
+}
+
+CoreServer::CoreServer(IrcClient* client, QObject* parent)
+    : QObject(parent), client(client), server(new QLocalServer(this)),
+      instanceId(QRandomGenerator::global()->generate64()) {
+    connect(server, &QLocalServer::newConnection, this, &CoreServer::handleNewConnection);
+
+    // Forward everything the session reports as compact events
+    connect(client, &IrcClient::connected, this, [this]() {
+        broadcastEvent("connected", {this->client->nickname(), this->client->localAddress().toString()});
+    });
+    connect(client, &IrcClient::disconnected, this, [this]() {
+        broadcastEvent("disconnected", {});
+    });
+    connect(client, &IrcClient::messageReceived, this, [this](const IrcMessage& message) {
+        if (message.command == "005") broadcastEvent("isupport", message.params.split(' ', Qt::SkipEmptyParts).mid(1));
+    });
+    connect(client, &IrcClient::lineAdded, this, [this](const ScrollbackLine& line) {
+        for (auto it = attachments.begin(); it != attachments.end(); ++it) {
+            if (it->synced) sendLines(it.key(), {line});
+        }
+    });
+    // Each front-end runs its own transfers, so only one of them may see an
+    // offer; otherwise two GUIs would accept it and write the same file
+    connect(client, &IrcClient::ctcpReceived, this, [this](const QString& nick, const QString& text) {
+        if (transferOwner) sendEvent(transferOwner, "ctcp", {nick, text});
+    });
+    connect(client, &IrcClient::userJoined, this, [this](const QString& channel, const QString& nick) {
+        const IrcUser* user = this->client->state()->user(nick);
+        broadcastEvent("join", {channel, user ? fullPrefix(user) : nick});
+    });
+    connect(client, &IrcClient::userLeft, this, [this](const QString& channel, const QString& nick) {
+        broadcastEvent("part", {channel, nick});
+    });
+    connect(client, &IrcClient::userQuit, this,
+            [this](const QString& nick, const QStringList& channels, const QString& reason) {
+        broadcastEvent("quit", QStringList{nick, reason} + channels);
+    });
+    connect(client, &IrcClient::nickChanged, this,
+            [this](const QString& oldNick, const QString& newNick, const QStringList& channels) {
+        broadcastEvent("nick", QStringList{oldNick, newNick} + channels);
+    });
+    connect(client, &IrcClient::channelModesChanged, this,
+            [this](const QString& channel, const QString& modes, const QStringList& args) {
+        broadcastEvent("mode", QStringList{channel, modes} + args);
+    });
+    connect(client, &IrcClient::namesReceived, this, [this](const QString& channel) {
+        broadcastEvent("names", QStringList{channel} + memberEntries(channel));
+    });
+    connect(client, &IrcClient::topicChanged, this, [this](const QString& channel, const QString& topic) {
+        broadcastEvent("topic", {channel, topic});
+    });
+    connect(client, &IrcClient::awayChanged, this, [this](const QString& nick, bool away) {
+        broadcastEvent("away", {nick, away ? "1" : "0"});
+    });
+    connect(client, &IrcClient::accountChanged, this, [this](const QString& nick, const QString& account) {
+        broadcastEvent("account", {nick, account});
+    });
+    connect(client, &IrcClient::error, this, [this](const QString& error) {
+        broadcastEvent("error", {error});
+    });
+    connect(client, &IrcClient::importProgress, this, [this](qint64 done, qint64 total) {
+        broadcastEvent("importProgress", {QString::number(done), QString::number(total)});
+    });
+    connect(client, &IrcClient::historyChanged, this, [this]() {
+        broadcastEvent("history", {QString::number(this->client->historyRevision())});
+    });
+    connect(client, &IrcClient::importFinished, this, [this](qint64 lines, const QString& error) {
+        broadcastEvent("importFinished", {QString::number(lines), error});
+    });
+}
+
+bool CoreServer::listen(const QString& name) {
+    // Refuse to steal the socket from a core that is still running
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(500)) {
+        qWarning() << "A core is already listening on" << name;
+        return false;
+    }
+
+    QLocalServer::removeServer(name);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server->listen(name)) {
+        qWarning() << "Cannot listen on" << name << ":" << server->errorString();
+        return false;
+    }
+    qDebug() << "Core listening on" << server->fullServerName();
+    return true;
+}
+
+void CoreServer::handleNewConnection() {
+    while (QLocalSocket* socket = server->nextPendingConnection()) {
+        attachments.insert(socket, Attachment());
+        connect(socket, &QLocalSocket::readyRead, this, &CoreServer::handleReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &CoreServer::handleDisconnected);
+        qDebug() << "Front-end attached";
+    }
+}
+
+void CoreServer::handleReadyRead() {
+    auto socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket || !attachments.contains(socket)) return;
+
+    attachments[socket].buffer.append(socket->readAll());
+    CoreProtocol::Type type;
+    QByteArray payload;
+    while (attachments.contains(socket) &&
+           CoreProtocol::takeFrame(attachments[socket].buffer, type, payload)) {
+        handleFrame(socket, type, payload);
+    }
+}
+
+void CoreServer::handleDisconnected() {
+    auto socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket) return;
+    attachments.remove(socket);
+    if (socket == transferOwner) {
+        transferOwner = nullptr;
+        for (auto it = attachments.cbegin(); it != attachments.cend() && !transferOwner; ++it) {
+            if (it->synced) transferOwner = it.key();
+        }
+    }
+    socket->deleteLater();
+    qDebug() << "Front-end detached";
+}
+
+void CoreServer::handleFrame(QLocalSocket* socket, CoreProtocol::Type type, const QByteArray& payload) {
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    if (type == CoreProtocol::Hello) {
+        handleHello(socket, in);
+    } else if (type == CoreProtocol::Command) {
+        QString kind;
+        QStringList args;
+        in >> kind >> args;
+        handleCommand(kind, args);
+    }
+}
+
+void CoreServer::handleHello(QLocalSocket* socket, QDataStream& in) {
+    quint32 version = 0;
+    quint64 knownInstance = 0;
+    quint64 lastSeq = 0;
+    in >> version >> knownInstance >> lastSeq;
+
+    if (version != CoreProtocol::Version) {
+        qWarning() << "Front-end speaks protocol" << version << "instead of" << CoreProtocol::Version;
+        socket->disconnectFromServer();
+        return;
+    }
+
+    // Sequence numbers only mean something within one core instance
+    if (knownInstance != instanceId) lastSeq = 0;
+
+    sendSnapshot(socket);
+    sendLines(socket, client->scrollback()->since(lastSeq));
+    attachments[socket].synced = true;
+    if (!transferOwner) transferOwner = socket;
+}
+
+void CoreServer::handleCommand(const QString& kind, const QStringList& args) {
+    if (kind == "connect") client->connectToServer(args.value(0), args.value(1, "6667").toUShort());
+    else if (kind == "disconnect") client->disconnect();
+    else if (kind == "raw") client->sendRaw(args.value(0));
+    else if (kind == "message") client->sendMessage(args.value(0), args.value(1));
+    else if (kind == "join") client->joinChannel(args.value(0));
+    else if (kind == "nick") client->setNickname(args.value(0));
+    else if (kind == "user") client->setUsername(args.value(0));
+    else if (kind == "ignore") client->setIgnoreRules(args);
+    else if (kind == "highlight") client->setHighlightRules(args);
+    else if (kind == "import") client->importLogs(args);
+    else if (kind == "cancelImport") client->cancelImport();
+    else qDebug() << "Unknown front-end command:" << kind;
+}
+
+void CoreServer::sendSnapshot(QLocalSocket* socket) {
+    const IrcState* state = client->state();
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+
+    out << instanceId << client->nickname() << client->isConnected()
+        << client->localAddress().toString() << client->ignoreRules()
+        << client->highlightRules() << client->pluginReport() << state->isupport()
+        << client->historyRevision();
+
+    // Users go out once, channels refer to them by index
+    QStringList channelNames = state->channelNames();
+    QHash<const IrcUser*, quint32> userIndex;
+    QVector<const IrcUser*> users;
+    for (const QString& name : channelNames) {
+        const IrcChannel* chan = state->channel(name);
+        for (auto it = chan->members.cbegin(); it != chan->members.cend(); ++it) {
+            if (!userIndex.contains(it.key())) {
+                userIndex.insert(it.key(), users.size());
+                users.append(it.key());
+            }
+        }
+    }
+
+    out << quint32(users.size());
+    for (const IrcUser* user : users) {
+        out << user->nick << user->user << user->host << user->account << user->away;
+    }
+
+    out << quint32(channelNames.size());
+    for (const QString& name : channelNames) {
+        const IrcChannel* chan = state->channel(name);
+        out << chan->name << chan->topic << quint32(chan->members.size());
+        for (auto it = chan->members.cbegin(); it != chan->members.cend(); ++it) {
+            out << userIndex.value(it.key()) << it.value();
+        }
+    }
+
+    CoreProtocol::writeFrame(socket, CoreProtocol::Snapshot, payload);
+}
+
+void CoreServer::sendLines(QLocalSocket* socket, const QVector<ScrollbackLine>& lines) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+
+    out << quint32(lines.size());
+    for (const ScrollbackLine& line : lines) out << line;
+    CoreProtocol::writeFrame(socket, CoreProtocol::Lines, payload);
+}
+
+void CoreServer::broadcastEvent(const QString& kind, const QStringList& args) {
+    for (auto it = attachments.begin(); it != attachments.end(); ++it) {
+        if (it->synced) sendEvent(it.key(), kind, args);
+    }
+}
+
+void CoreServer::sendEvent(QLocalSocket* socket, const QString& kind, const QStringList& args) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << kind << args;
+    CoreProtocol::writeFrame(socket, CoreProtocol::Event, payload);
+}
+
+QStringList CoreServer::memberEntries(const QString& channel) const {
+    QStringList entries;
+    const IrcChannel* chan = client->state()->channel(channel);
+    if (!chan) return entries;
+
+    entries.reserve(chan->members.size());
+    for (auto it = chan->members.cbegin(); it != chan->members.cend(); ++it) {
+        entries << it.value() + fullPrefix(it.key());
+    }
+    return entries;
+}
\ No newline at end of file
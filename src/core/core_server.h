@@ -0,0 +1,43 @@
+#pragma once
+#include <QObject>
+#include <QHash>
+#include "protocol.h"
+
+class IrcClient;
+class QLocalServer;
+class QLocalSocket;
+
+// Serves a headless core's session to GUI front-ends over a local socket
+class CoreServer : public QObject {
+    Q_OBJECT
+public:
+    explicit CoreServer(IrcClient* client, QObject* parent = nullptr);
+
+    bool listen(const QString& name = CoreProtocol::socketName());
+
+private slots:
+    void handleNewConnection();
+    void handleReadyRead();
+    void handleDisconnected();
+
+private:
+    struct Attachment {
+        QByteArray buffer;
+        bool synced = false;
+    };
+
+    IrcClient* client;
+    QLocalServer* server;
+    QHash<QLocalSocket*, Attachment> attachments;
+    QLocalSocket* transferOwner = nullptr;  // the one front-end DCC offers go to
+    quint64 instanceId;
+
+    void handleFrame(QLocalSocket* socket, CoreProtocol::Type type, const QByteArray& payload);
+    void handleHello(QLocalSocket* socket, QDataStream& in);
+    void handleCommand(const QString& kind, const QStringList& args);
+    void sendSnapshot(QLocalSocket* socket);
+    void sendLines(QLocalSocket* socket, const QVector<ScrollbackLine>& lines);
+    void broadcastEvent(const QString& kind, const QStringList& args);
+    void sendEvent(QLocalSocket* socket, const QString& kind, const QStringList& args);
+    QStringList memberEntries(const QString& channel) const;
+};
\ No newline at end of file
@@ -0,0 +1,694 @@
+#include "dcc.h"
+#include "session.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+const int PollInterval = 250;        // ms between cancellation checks
+const int ConnectTimeout = 120000;   // ms to wait for the peer to connect
+const int LingerTimeout = 30000;     // ms to wait for the final ack
+const int ProgressInterval = 250;    // ms between progress reports
+const qint64 SendChunk = 1 << 20;
+const int ReceiveBuffer = 4 << 20;
+
+int pollFd(int fd, short events, int timeout) {
+    pollfd entry{fd, events, 0};
+    return ::poll(&entry, 1, timeout);
+}
+
+QString systemError() {
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+bool writeAll(int fd, const char* data, qint64 length) {
+    while (length > 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+}
+
+QString DccTransfer::statusText() const {
+    switch (status) {
+    case Offered: return QObject::tr("Offered");
+    case Waiting: return QObject::tr("Waiting");
+    case Resuming: return QObject::tr("Resuming");
+    case Transferring: return QObject::tr("Transferring");
+    case Done: return QObject::tr("Done");
+    case Failed: return QObject::tr("Failed: %1").arg(error);
+    case Cancelled: return QObject::tr("Cancelled");
+    }
+    return QString();
+}
+
+DccWorker::DccWorker(int id, DccTransfer::Direction direction, QObject* parent)
+    : QThread(parent), id(id), direction(direction) {
+}
+
+DccWorker::~DccWorker() {
+    cancel();
+    wait();
+    if (listenFd >= 0) ::close(listenFd);
+}
+
+void DccWorker::setPeer(const QHostAddress& address, quint16 port) {
+    peerAddress = address;
+    peerPort = port;
+}
+
+void DccWorker::setFile(const QString& filePath, qint64 fileSize, qint64 fileOffset) {
+    path = filePath;
+    size = fileSize;
+    offset = fileOffset;
+}
+
+void DccWorker::run() {
+    QString error;
+    int sock = openConnection(error);
+    if (sock >= 0) {
+        error = direction == DccTransfer::Send ? sendFile(sock) : receiveFile(sock);
+        ::close(sock);
+    }
+    if (cancelled) error = tr("Cancelled");
+    emit completed(id, error);
+}
+
+int DccWorker::openConnection(QString& error) {
+    if (listenFd >= 0) {
+        QElapsedTimer waited;
+        waited.start();
+        while (!cancelled) {
+            int ready = pollFd(listenFd, POLLIN, PollInterval);
+            if (ready > 0) {
+                int sock = ::accept(listenFd, nullptr, nullptr);
+                if (sock < 0) error = systemError();
+                ::close(listenFd);
+                listenFd = -1;
+                return sock;
+            }
+            if (ready < 0 && errno != EINTR) {
+                error = systemError();
+                return -1;
+            }
+            if (waited.elapsed() > ConnectTimeout) {
+                error = tr("Timed out waiting for the peer to connect");
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    sockaddr_storage addr{};
+    socklen_t length = 0;
+    if (peerAddress.protocol() == QAbstractSocket::IPv6Protocol) {
+        auto in6 = reinterpret_cast<sockaddr_in6*>(&addr);
+        Q_IPV6ADDR ip = peerAddress.toIPv6Address();
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(peerPort);
+        std::memcpy(&in6->sin6_addr, &ip, sizeof(ip));
+        length = sizeof(sockaddr_in6);
+    } else {
+        auto in4 = reinterpret_cast<sockaddr_in*>(&addr);
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(peerPort);
+        in4->sin_addr.s_addr = htonl(peerAddress.toIPv4Address());
+        length = sizeof(sockaddr_in);
+    }
+
+    int sock = ::socket(addr.ss_family, SOCK_STREAM, 0);
+    if (sock < 0) {
+        error = systemError();
+        return -1;
+    }
+
+    // Connect without blocking so a dead peer times out and cancel still works
+    int flags = ::fcntl(sock, F_GETFL, 0);
+    ::fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    if (::connect(sock, reinterpret_cast<sockaddr*>(&addr), length) < 0 && errno != EINPROGRESS) {
+        error = systemError();
+        ::close(sock);
+        return -1;
+    }
+
+    QElapsedTimer waited;
+    waited.start();
+    while (true) {
+        if (cancelled) {
+            ::close(sock);
+            return -1;
+        }
+        int ready = pollFd(sock, POLLOUT, PollInterval);
+        if (ready > 0) break;
+        if (ready < 0 && errno != EINTR) {
+            error = systemError();
+            ::close(sock);
+            return -1;
+        }
+        if (waited.elapsed() > ConnectTimeout) {
+            error = tr("Timed out connecting to the peer");
+            ::close(sock);
+            return -1;
+        }
+    }
+
+    int result = 0;
+    socklen_t resultLength = sizeof(result);
+    if (::getsockopt(sock, SOL_SOCKET, SO_ERROR, &result, &resultLength) < 0 || result != 0) {
+        if (result != 0) errno = result;
+        error = systemError();
+        ::close(sock);
+        return -1;
+    }
+    ::fcntl(sock, F_SETFL, flags);
+    return sock;
+}
+
+QString DccWorker::sendFile(int sock) {
+    int file = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (file < 0) return systemError();
+
+    // Peers acknowledge with 32-bit big-endian byte counts. Nobody needs
+    // them for flow control any more, but they are read so the peer never
+    // blocks on a full socket, and the last one tells us we are done.
+    const quint32 expected = quint32(size);
+    quint32 lastAck = 0;
+    qint64 ackBytes = 0;
+    auto drainAcks = [&](int flags) -> int {
+        char acks[4096];
+        ssize_t n = ::recv(sock, acks, sizeof(acks), flags);
+        for (ssize_t i = 0; i < n; i++) {
+            lastAck = (lastAck << 8) | quint8(acks[i]);
+            if (++ackBytes % 4 == 0 && lastAck == expected) return 1;
+        }
+        // A hangup or a real error ends the wait; only "try again" does not
+        if (n == 0) return -1;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) return -1;
+        return 0;
+    };
+
+#ifndef Q_OS_LINUX
+    char* mapped = nullptr;
+    if (size > 0) {
+        void* region = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+        if (region == MAP_FAILED) {
+            QString error = systemError();
+            ::close(file);
+            return error;
+        }
+        mapped = static_cast<char*>(region);
+    }
+#endif
+
+    off_t position = offset;
+    const qint64 start = position;
+    QElapsedTimer clock, reported;
+    clock.start();
+    reported.start();
+    QString error;
+
+    while (position < size && !cancelled) {
+        drainAcks(MSG_DONTWAIT);
+
+        int ready = pollFd(sock, POLLOUT, PollInterval);
+        if (ready == 0) continue;
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            error = systemError();
+            break;
+        }
+
+        qint64 chunk = qMin(SendChunk, size - qint64(position));
+#ifdef Q_OS_LINUX
+        ssize_t sent = ::sendfile(sock, file, &position, chunk);
+#else
+        ssize_t sent = ::send(sock, mapped + position, chunk, MSG_NOSIGNAL);
+        if (sent > 0) position += sent;
+#endif
+        if (sent < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            error = systemError();
+            break;
+        }
+        if (sent == 0) {
+            error = tr("File shrank while sending");
+            break;
+        }
+
+        if (reported.elapsed() >= ProgressInterval) {
+            emit progress(id, position, (position - start) * 1000.0 / qMax<qint64>(1, clock.elapsed()));
+            reported.restart();
+        }
+    }
+
+#ifndef Q_OS_LINUX
+    if (mapped) ::munmap(mapped, size);
+#endif
+    ::close(file);
+
+    if (error.isEmpty() && !cancelled) {
+        emit progress(id, position, (position - start) * 1000.0 / qMax<qint64>(1, clock.elapsed()));
+
+        // Wait for the peer to confirm everything or hang up
+        QElapsedTimer linger;
+        linger.start();
+        while (!cancelled && linger.elapsed() < LingerTimeout) {
+            if (pollFd(sock, POLLIN, PollInterval) <= 0) continue;
+            if (drainAcks(0) != 0) break;
+        }
+    }
+    return error;
+}
+
+QString DccWorker::receiveFile(int sock) {
+    int flags = O_WRONLY | O_CREAT | (offset > 0 ? 0 : O_TRUNC);
+    int file = ::open(QFile::encodeName(path).constData(), flags, 0644);
+    if (file < 0) return systemError();
+    if (offset > 0 && ::lseek(file, offset, SEEK_SET) < 0) {
+        QString error = systemError();
+        ::close(file);
+        return error;
+    }
+
+    QByteArray buffer(ReceiveBuffer, Qt::Uninitialized);
+    qint64 filled = 0;
+    qint64 received = offset;
+    const qint64 start = received;
+    QElapsedTimer clock, reported;
+    clock.start();
+    reported.start();
+    QString error;
+
+    while (!cancelled && (size == 0 || received < size)) {
+        int ready = pollFd(sock, POLLIN, PollInterval);
+        if (ready == 0) continue;
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            error = systemError();
+            break;
+        }
+
+        ssize_t n = ::recv(sock, buffer.data() + filled, buffer.size() - filled, 0);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error = systemError();
+            break;
+        }
+        filled += n;
+        received += n;
+
+        quint32 ack = qToBigEndian(quint32(received));
+        ::send(sock, &ack, sizeof(ack), MSG_NOSIGNAL);
+
+        if (filled == buffer.size()) {
+            if (!writeAll(file, buffer.constData(), filled)) {
+                error = systemError();
+                break;
+            }
+            filled = 0;
+        }
+
+        if (reported.elapsed() >= ProgressInterval) {
+            emit progress(id, received, (received - start) * 1000.0 / qMax<qint64>(1, clock.elapsed()));
+            reported.restart();
+        }
+    }
+
+    if (filled > 0 && error.isEmpty() && !writeAll(file, buffer.constData(), filled)) {
+        error = systemError();
+    }
+    ::close(file);
+
+    if (error.isEmpty() && !cancelled) {
+        emit progress(id, received, (received - start) * 1000.0 / qMax<qint64>(1, clock.elapsed()));
+        if (size > 0 && received < size) {
+            error = tr("Connection closed after %1 of %2 bytes").arg(received).arg(size);
+        }
+    }
+    return error;
+}
+
+DccManager::DccManager(Session* client, QObject* parent) : QObject(parent), client(client) {
+    // sendfile(2) has no MSG_NOSIGNAL, so a peer hanging up must not kill us
+    std::signal(SIGPIPE, SIG_IGN);
+    connect(client, &Session::ctcpReceived, this, &DccManager::handleCtcp);
+}
+
+DccManager::~DccManager() {
+    for (auto& transfer : transfers) {
+        if (transfer.worker) transfer.worker->cancel();
+    }
+}
+
+int DccManager::sendFile(const QString& nick, const QString& path, bool passive) {
+    QFileInfo info(path);
+
+    DccTransfer& transfer = transfers[nextId];
+    transfer.id = nextId++;
+    transfer.direction = DccTransfer::Send;
+    transfer.nick = nick;
+    transfer.fileName = info.fileName();
+    transfer.path = info.absoluteFilePath();
+    transfer.size = info.size();
+    transfer.passive = passive;
+
+    if (!info.isFile() || !info.isReadable()) {
+        fail(transfer, tr("Cannot read %1").arg(path));
+        emit transferAdded(transfer.id);
+        return transfer.id;
+    }
+
+    if (passive) {
+        // Reverse DCC: the receiver listens and answers with its own port
+        transfer.token = QString::number(QRandomGenerator::global()->bounded(1, 1000000));
+        transfer.status = DccTransfer::Waiting;
+        client->sendCtcp(nick, QString("DCC SEND %1 %2 0 %3 %4")
+            .arg(quoteFileName(transfer.fileName), localAddressArg())
+            .arg(transfer.size)
+            .arg(transfer.token));
+    } else {
+        QString error;
+        int fd = listen(transfer.port, error);
+        if (fd < 0) {
+            fail(transfer, error);
+            emit transferAdded(transfer.id);
+            return transfer.id;
+        }
+        transfer.status = DccTransfer::Waiting;
+        startSending(transfer, fd);
+        client->sendCtcp(nick, QString("DCC SEND %1 %2 %3 %4")
+            .arg(quoteFileName(transfer.fileName), localAddressArg())
+            .arg(transfer.port)
+            .arg(transfer.size));
+    }
+
+    emit transferAdded(transfer.id);
+    return transfer.id;
+}
+
+void DccManager::accept(int id, const QString& savePath, bool resume) {
+    auto it = transfers.find(id);
+    if (it == transfers.end() || it->direction != DccTransfer::Receive ||
+        it->status != DccTransfer::Offered) return;
+
+    DccTransfer& transfer = *it;
+    transfer.path = savePath;
+
+    QFileInfo existing(savePath);
+    if (resume && existing.isFile() && existing.size() > 0 && existing.size() < transfer.size) {
+        // Ask the sender to pick up where the partial file ends
+        transfer.offset = existing.size();
+        transfer.status = DccTransfer::Resuming;
+        QString resume = QString("DCC RESUME %1 %2 %3")
+            .arg(quoteFileName(transfer.fileName))
+            .arg(transfer.port)
+            .arg(transfer.offset);
+        if (!transfer.token.isEmpty()) resume += ' ' + transfer.token;
+        client->sendCtcp(transfer.nick, resume);
+    } else {
+        transfer.offset = 0;
+        startReceiving(transfer);
+    }
+    emit transferUpdated(id);
+}
+
+void DccManager::cancel(int id) {
+    auto it = transfers.find(id);
+    if (it == transfers.end()) return;
+    if (it->status == DccTransfer::Done || it->status == DccTransfer::Failed) return;
+
+    if (it->worker) it->worker->cancel();
+    it->status = DccTransfer::Cancelled;
+    emit transferUpdated(id);
+}
+
+const DccTransfer* DccManager::transfer(int id) const {
+    auto it = transfers.constFind(id);
+    return it == transfers.constEnd() ? nullptr : &*it;
+}
+
+void DccManager::handleCtcp(const QString& nick, const QString& text) {
+    if (!text.startsWith("DCC ", Qt::CaseInsensitive)) return;
+
+    QString rest = text.mid(4).trimmed();
+    QString type = rest.section(' ', 0, 0).toUpper();
+    QStringList args = splitArgs(rest.section(' ', 1));
+
+    if (type == "SEND") handleSendOffer(nick, args);
+    else if (type == "RESUME") handleResume(nick, args);
+    else if (type == "ACCEPT") handleAccept(nick, args);
+    else qDebug() << "Unsupported DCC request from" << nick << ":" << type;
+}
+
+void DccManager::handleSendOffer(const QString& nick, const QStringList& args) {
+    if (args.size() < 4) return;
+
+    QHostAddress address = parseAddress(args[1]);
+    quint16 port = args[2].toUShort();
+    QString token = args.value(4);
+
+    // A non-zero port with a token answers one of our passive offers
+    if (port != 0 && !token.isEmpty()) {
+        if (DccTransfer* transfer = findTransfer(DccTransfer::Send, nick, 0, token)) {
+            if (transfer->status == DccTransfer::Waiting) {
+                transfer->address = address;
+                transfer->port = port;
+                startSending(*transfer, -1);
+                emit transferUpdated(transfer->id);
+            }
+            return;
+        }
+    }
+
+    DccTransfer& transfer = transfers[nextId];
+    transfer.id = nextId++;
+    transfer.direction = DccTransfer::Receive;
+    transfer.status = DccTransfer::Offered;
+    transfer.nick = nick;
+    // Never trust a path from the peer
+    transfer.fileName = QFileInfo(args[0]).fileName();
+    transfer.size = args[3].toLongLong();
+    transfer.address = address;
+    transfer.port = port;
+    transfer.passive = port == 0;
+    transfer.token = token;
+    emit transferAdded(transfer.id);
+}
+
+void DccManager::handleResume(const QString& nick, const QStringList& args) {
+    if (args.size() < 3) return;
+
+    quint16 port = args[1].toUShort();
+    qint64 position = args[2].toLongLong();
+    QString token = args.value(3);
+
+    DccTransfer* transfer = findTransfer(DccTransfer::Send, nick, port, token);
+    if (!transfer || transfer->status != DccTransfer::Waiting) return;
+    if (position <= 0 || position >= transfer->size) return;
+
+    transfer->offset = position;
+    transfer->transferred = position;
+    if (transfer->worker) transfer->worker->setOffset(position);
+
+    QString reply = QString("DCC ACCEPT %1 %2 %3").arg(quoteFileName(args[0])).arg(port).arg(position);
+    if (!token.isEmpty()) reply += ' ' + token;
+    client->sendCtcp(nick, reply);
+    emit transferUpdated(transfer->id);
+}
+
+void DccManager::handleAccept(const QString& nick, const QStringList& args) {
+    if (args.size() < 3) return;
+
+    quint16 port = args[1].toUShort();
+    qint64 position = args[2].toLongLong();
+    QString token = args.value(3);
+
+    DccTransfer* transfer = findTransfer(DccTransfer::Receive, nick, port, token);
+    if (!transfer || transfer->status != DccTransfer::Resuming) return;
+
+    transfer->offset = position;
+    transfer->transferred = position;
+    startReceiving(*transfer);
+    emit transferUpdated(transfer->id);
+}
+
+void DccManager::handleProgress(int id, qint64 transferred, double rate) {
+    auto it = transfers.find(id);
+    if (it == transfers.end() || it->status == DccTransfer::Cancelled) return;
+
+    it->transferred = transferred;
+    it->rate = rate;
+    it->status = DccTransfer::Transferring;
+    emit transferUpdated(id);
+}
+
+void DccManager::handleCompleted(int id, const QString& error) {
+    auto it = transfers.find(id);
+    if (it == transfers.end()) return;
+
+    if (it->worker) {
+        it->worker->wait();
+        it->worker->deleteLater();
+        it->worker = nullptr;
+    }
+
+    if (it->status == DccTransfer::Cancelled) {
+        // Keep the cancelled state
+    } else if (error.isEmpty()) {
+        it->status = DccTransfer::Done;
+    } else {
+        fail(*it, error);
+    }
+    it->rate = 0.0;
+    emit transferUpdated(id);
+}
+
+void DccManager::startSending(DccTransfer& transfer, int listenFd) {
+    auto worker = new DccWorker(transfer.id, DccTransfer::Send, this);
+    if (listenFd >= 0) worker->setListener(listenFd);
+    else worker->setPeer(transfer.address, transfer.port);
+    worker->setFile(transfer.path, transfer.size, transfer.offset);
+
+    connect(worker, &DccWorker::progress, this, &DccManager::handleProgress);
+    connect(worker, &DccWorker::completed, this, &DccManager::handleCompleted);
+    transfer.worker = worker;
+    worker->start();
+}
+
+void DccManager::startReceiving(DccTransfer& transfer) {
+    auto worker = new DccWorker(transfer.id, DccTransfer::Receive, this);
+
+    if (transfer.passive) {
+        QString error;
+        int fd = listen(transfer.port, error);
+        if (fd < 0) {
+            delete worker;
+            fail(transfer, error);
+            return;
+        }
+        worker->setListener(fd);
+        client->sendCtcp(transfer.nick, QString("DCC SEND %1 %2 %3 %4 %5")
+            .arg(quoteFileName(transfer.fileName), localAddressArg())
+            .arg(transfer.port)
+            .arg(transfer.size)
+            .arg(transfer.token));
+        transfer.status = DccTransfer::Waiting;
+    } else {
+        worker->setPeer(transfer.address, transfer.port);
+        transfer.status = DccTransfer::Transferring;
+    }
+    worker->setFile(transfer.path, transfer.size, transfer.offset);
+
+    connect(worker, &DccWorker::progress, this, &DccManager::handleProgress);
+    connect(worker, &DccWorker::completed, this, &DccManager::handleCompleted);
+    transfer.worker = worker;
+    worker->start();
+}
+
+void DccManager::fail(DccTransfer& transfer, const QString& error) {
+    qDebug() << "DCC transfer" << transfer.id << "failed:" << error;
+    transfer.status = DccTransfer::Failed;
+    transfer.error = error;
+}
+
+DccTransfer* DccManager::findTransfer(DccTransfer::Direction direction, const QString& nick,
+                                      quint16 port, const QString& token) {
+    QString key = client->state()->fold(nick);
+    for (auto& transfer : transfers) {
+        if (transfer.direction != direction) continue;
+        if (transfer.status == DccTransfer::Done || transfer.status == DccTransfer::Failed ||
+            transfer.status == DccTransfer::Cancelled) continue;
+        if (client->state()->fold(transfer.nick) != key) continue;
+        if (token.isEmpty() ? transfer.port == port : transfer.token == token) return &transfer;
+    }
+    return nullptr;
+}
+
+int DccManager::listen(quint16& port, QString& error) const {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = systemError();
+        return -1;
+    }
+
+    int yes = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = 0;
+    socklen_t length = sizeof(addr);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(fd, 1) < 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) < 0) {
+        error = systemError();
+        ::close(fd);
+        return -1;
+    }
+
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+QString DccManager::localAddressArg() const {
+    // DCC traditionally sends IPv4 addresses as a single decimal integer
+    QHostAddress address = client->localAddress();
+    bool isIPv4 = false;
+    quint32 ip = address.toIPv4Address(&isIPv4);
+    return isIPv4 ? QString::number(ip) : address.toString();
+}
+
+QString DccManager::quoteFileName(const QString& name) {
+    return name.contains(' ') ? QString("\"%1\"").arg(name) : name;
+}
+
+QStringList DccManager::splitArgs(const QString& text) {
+    QStringList args;
+    QString rest = text.trimmed();
+    if (rest.startsWith('"')) {
+        int end = rest.indexOf('"', 1);
+        if (end > 0) {
+            args << rest.mid(1, end - 1);
+            rest = rest.mid(end + 1);
+        }
+    }
+    args += rest.split(' ', Qt::SkipEmptyParts);
+    return args;
+}
+
+QHostAddress DccManager::parseAddress(const QString& text) {
+    bool isNumber = false;
+    quint32 ip = text.toUInt(&isNumber);
+    return isNumber ? QHostAddress(ip) : QHostAddress(text);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <QObject>
+#include <QThread>
+#include <QHostAddress>
+#include <QMap>
+#include <atomic>
+
+class Session;
+class DccWorker;
+
+struct DccTransfer {
+    enum Direction { Send, Receive };
+    enum Status { Offered, Waiting, Resuming, Transferring, Done, Failed, Cancelled };
+
+    int id = 0;
+    Direction direction = Send;
+    Status status = Offered;
+    QString nick;
+    QString fileName;
+    QString path;
+    qint64 size = 0;
+    qint64 offset = 0;          // resume position
+    qint64 transferred = 0;     // bytes including the resumed part
+    double rate = 0.0;          // bytes per second
+    bool passive = false;
+    QString token;
+    QHostAddress address;
+    quint16 port = 0;
+    QString error;
+    DccWorker* worker = nullptr;
+
+    QString statusText() const;
+};
+
+// Moves one file over an already arranged DCC connection on its own
+// thread. Outgoing data goes through sendfile(2) straight from the page
+// cache; incoming data is collected into large buffers before writing.
+class DccWorker : public QThread {
+    Q_OBJECT
+public:
+    DccWorker(int id, DccTransfer::Direction direction, QObject* parent = nullptr);
+    ~DccWorker() override;
+
+    void setListener(int fd) { listenFd = fd; }
+    void setPeer(const QHostAddress& address, quint16 port);
+    void setFile(const QString& path, qint64 size, qint64 offset);
+    void setOffset(qint64 position) { offset = position; }
+    void cancel() { cancelled = true; }
+
+signals:
+    void progress(int id, qint64 transferred, double rate);
+    void completed(int id, const QString& error);
+
+protected:
+    void run() override;
+
+private:
+    int id;
+    DccTransfer::Direction direction;
+    int listenFd = -1;
+    QHostAddress peerAddress;
+    quint16 peerPort = 0;
+    QString path;
+    qint64 size = 0;
+    std::atomic<qint64> offset{0};  // may still change via RESUME until connected
+    std::atomic<bool> cancelled{false};
+
+    int openConnection(QString& error);
+    QString sendFile(int sock);
+    QString receiveFile(int sock);
+};
+
+class DccManager : public QObject {
+    Q_OBJECT
+public:
+    explicit DccManager(Session* client, QObject* parent = nullptr);
+    ~DccManager() override;
+
+    int sendFile(const QString& nick, const QString& path, bool passive = false);
+    void accept(int id, const QString& savePath, bool resume = true);
+    void cancel(int id);
+    const DccTransfer* transfer(int id) const;
+
+signals:
+    void transferAdded(int id);
+    void transferUpdated(int id);
+
+private slots:
+    void handleCtcp(const QString& nick, const QString& text);
+    void handleProgress(int id, qint64 transferred, double rate);
+    void handleCompleted(int id, const QString& error);
+
+private:
+    Session* client;
+    QMap<int, DccTransfer> transfers;
+    int nextId = 1;
+
+    void handleSendOffer(const QString& nick, const QStringList& args);
+    void handleResume(const QString& nick, const QStringList& args);
+    void handleAccept(const QString& nick, const QStringList& args);
+
+    void startSending(DccTransfer& transfer, int listenFd);
+    void startReceiving(DccTransfer& transfer);
+    void fail(DccTransfer& transfer, const QString& error);
+    DccTransfer* findTransfer(DccTransfer::Direction direction, const QString& nick,
+                              quint16 port, const QString& token);
+
+    int listen(quint16& port, QString& error) const;
+    QString localAddressArg() const;
+    static QString quoteFileName(const QString& name);
+    static QStringList splitArgs(const QString& text);
+    static QHostAddress parseAddress(const QString& text);
+};
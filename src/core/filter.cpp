@@ -0,0 +1,173 @@
+#include "filter.h"
+#include <QDebug>
+#include <QQueue>
+
+void MessageFilter::setIgnoreRules(const QStringList& rules) {
+    auto compiled = compile(rules);
+    QMutexLocker lock(&mutex);
+    ignores = compiled;
+}
+
+void MessageFilter::setHighlightRules(const QStringList& rules) {
+    auto compiled = compile(rules);
+    QMutexLocker lock(&mutex);
+    highlights = compiled;
+}
+
+QStringList MessageFilter::ignoreRules() const {
+    QMutexLocker lock(&mutex);
+    return ignores ? ignores->rules : QStringList();
+}
+
+QStringList MessageFilter::highlightRules() const {
+    QMutexLocker lock(&mutex);
+    return highlights ? highlights->rules : QStringList();
+}
+
+MessageFilter::Verdict MessageFilter::apply(const IrcMessage& message) const {
+    QSharedPointer<const RuleSet> ignoreSet, highlightSet;
+    {
+        QMutexLocker lock(&mutex);
+        ignoreSet = ignores;
+        highlightSet = highlights;
+    }
+
+    if (ignoreSet && ignoreSet->matches(message)) return Ignore;
+    if (highlightSet && highlightSet->matches(message)) return Highlight;
+    return Pass;
+}
+
+QSharedPointer<const MessageFilter::RuleSet> MessageFilter::compile(const QStringList& rules) {
+    auto set = QSharedPointer<RuleSet>::create();
+    QStringList keywords, masks, patterns, separate;
+
+    for (const QString& entry : rules) {
+        QString rule = entry.trimmed();
+        if (rule.isEmpty()) continue;
+        set->rules << rule;
+
+        if (rule.size() > 2 && rule.startsWith('/') && rule.endsWith('/')) {
+            QString pattern = rule.mid(1, rule.size() - 2);
+            if (!QRegularExpression(pattern).isValid()) {
+                qWarning() << "Skipping invalid filter regex:" << rule;
+                continue;
+            }
+            // Joining renumbers groups, which breaks \1 and friends
+            static const QRegularExpression backReference("\\\\(?:[1-9]|g|k)|\\(\\?P=");
+            if (backReference.match(pattern).hasMatch()) separate << pattern;
+            else patterns << QString("(?:%1)").arg(pattern);
+        } else if (rule.contains('!') || rule.contains('@')) {
+            masks << maskToPattern(rule);
+        } else {
+            keywords << rule;
+        }
+    }
+
+    set->keywords.build(keywords);
+    if (!masks.isEmpty()) {
+        set->masks = QRegularExpression(QString("^(?:%1)$").arg(masks.join('|')),
+                                        QRegularExpression::CaseInsensitiveOption);
+        set->masks.optimize();
+    }
+    if (!patterns.isEmpty()) {
+        QRegularExpression joined(patterns.join('|'), QRegularExpression::CaseInsensitiveOption);
+        if (!joined.isValid()) {
+            // Something clashes, e.g. a named group used twice; keep every
+            // rule that still joins and match only the clashing ones apart
+            qWarning() << "Filter regexes cannot all be combined (" << joined.errorString()
+                       << "), matching the clashing ones one by one";
+            QStringList joinable;
+            for (const QString& pattern : qAsConst(patterns)) {
+                QStringList candidate = joinable;
+                candidate << pattern;
+                if (QRegularExpression(candidate.join('|')).isValid()) joinable = candidate;
+                else separate << pattern;
+            }
+            joined = QRegularExpression(joinable.join('|'), QRegularExpression::CaseInsensitiveOption);
+        }
+        if (!joined.pattern().isEmpty()) {
+            set->patterns = joined;
+            set->patterns.optimize();
+        }
+    }
+    for (const QString& pattern : qAsConst(separate)) {
+        QRegularExpression single(pattern, QRegularExpression::CaseInsensitiveOption);
+        single.optimize();
+        set->separatePatterns << single;
+    }
+    return set;
+}
+
+QString MessageFilter::maskToPattern(const QString& mask) {
+    QString pattern;
+    for (QChar c : mask) {
+        if (c == '*') pattern += ".*";
+        else if (c == '?') pattern += '.';
+        else pattern += QRegularExpression::escape(QString(c));
+    }
+    return pattern;
+}
+
+bool MessageFilter::RuleSet::matches(const IrcMessage& message) const {
+    if (!masks.pattern().isEmpty() && !message.prefix.isEmpty() &&
+        masks.match(message.prefix).hasMatch()) {
+        return true;
+    }
+    if (message.trailing.isEmpty()) return false;
+    if (!keywords.isEmpty() && keywords.matches(message.trailing)) return true;
+    if (!patterns.pattern().isEmpty() && patterns.match(message.trailing).hasMatch()) return true;
+    for (const QRegularExpression& pattern : separatePatterns) {
+        if (pattern.match(message.trailing).hasMatch()) return true;
+    }
+    return false;
+}
+
+void MessageFilter::KeywordMatcher::build(const QStringList& keywords) {
+    nodes.clear();
+    nodes.append(Node());
+
+    for (const QString& keyword : keywords) {
+        int state = 0;
+        for (QChar c : keyword.toCaseFolded()) {
+            int next = nodes[state].next.value(c.unicode(), -1);
+            if (next == -1) {
+                next = nodes.size();
+                nodes.append(Node());
+                nodes[state].next.insert(c.unicode(), next);
+            }
+            state = next;
+        }
+        nodes[state].terminal = true;
+    }
+
+    // Breadth-first pass to wire failure links
+    QQueue<int> queue;
+    for (int child : nodes[0].next) queue.enqueue(child);
+
+    while (!queue.isEmpty()) {
+        int state = queue.dequeue();
+        const auto edges = nodes[state].next;
+        for (auto it = edges.cbegin(); it != edges.cend(); ++it) {
+            int fail = nodes[state].fail;
+            while (fail && !nodes[fail].next.contains(it.key())) {
+                fail = nodes[fail].fail;
+            }
+            fail = nodes[fail].next.value(it.key(), 0);
+            nodes[it.value()].fail = fail;
+            nodes[it.value()].terminal |= nodes[fail].terminal;
+            queue.enqueue(it.value());
+        }
+    }
+}
+
+bool MessageFilter::KeywordMatcher::matches(const QString& text) const {
+    int state = 0;
+    for (QChar c : text.toCaseFolded()) {
+        while (state && !nodes[state].next.contains(c.unicode())) {
+            state = nodes[state].fail;
+        }
+        state = nodes[state].next.value(c.unicode(), 0);
+        if (nodes[state].terminal) return true;
+    }
+    return false;
+}
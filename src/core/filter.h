@@ -0,0 +1,60 @@
+#pragma once
+#include <QHash>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include "message.h"
+
+// Ignore and highlight rules, compiled once into a single matcher per list.
+//
+// Rule syntax, one rule per entry:
+//   nick!user@host   mask against the message prefix, * and ? wildcards
+//   /regex/          regular expression against the message text
+//   anything else    case-insensitive keyword against the message text
+class MessageFilter {
+public:
+    enum Verdict { Pass, Ignore, Highlight };
+
+    void setIgnoreRules(const QStringList& rules);
+    void setHighlightRules(const QStringList& rules);
+    QStringList ignoreRules() const;
+    QStringList highlightRules() const;
+
+    Verdict apply(const IrcMessage& message) const;
+
+private:
+    // Aho-Corasick automaton over case-folded UTF-16 code units
+    class KeywordMatcher {
+    public:
+        void build(const QStringList& keywords);
+        bool isEmpty() const { return nodes.size() <= 1; }
+        bool matches(const QString& text) const;
+
+    private:
+        struct Node {
+            QHash<ushort, int> next;
+            int fail = 0;
+            bool terminal = false;
+        };
+        QVector<Node> nodes;
+    };
+
+    struct RuleSet {
+        QStringList rules;
+        KeywordMatcher keywords;
+        QRegularExpression masks;
+        QRegularExpression patterns;
+        QVector<QRegularExpression> separatePatterns;  // when they cannot be joined
+
+        bool matches(const IrcMessage& message) const;
+    };
+
+    static QSharedPointer<const RuleSet> compile(const QStringList& rules);
+    static QString maskToPattern(const QString& mask);
+
+    mutable QMutex mutex;
+    QSharedPointer<const RuleSet> ignores;
+    QSharedPointer<const RuleSet> highlights;
+};
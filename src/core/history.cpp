@@ -0,0 +1,161 @@
+#include "history.h"
+#include "protocol.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+
+const QString Suffix = ".dat";
+const QString ServerFile = "-";     // never produced by the encoding below
+
+}
+
+History::History(const QString& directory) : directory(directory) {
+}
+
+QString History::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history";
+}
+
+bool History::append(const QVector<ScrollbackLine>& batch) {
+    if (batch.isEmpty()) return true;
+    if (!QDir().mkpath(directory)) {
+        lastError = QString("Cannot create history directory %1").arg(directory);
+        qWarning().noquote() << lastError;
+        return false;
+    }
+
+    QHash<QString, QByteArray> records;
+    for (const ScrollbackLine& line : batch) {
+        QByteArray record;
+        QDataStream out(&record, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << line;
+        quint32 size = qToBigEndian(quint32(record.size()));
+        record.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        records[line.buffer.toLower()] += record;
+    }
+
+    for (auto it = records.cbegin(); it != records.cend(); ++it) {
+        QFile file(pathFor(it.key()));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(it.value()) != it->size()) {
+            lastError = QString("Cannot write history to %1: %2").arg(file.fileName(), file.errorString());
+            qWarning().noquote() << lastError;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool History::contains(const QString& buffer) const {
+    return QFile::exists(pathFor(buffer));
+}
+
+QStringList History::buffers() const {
+    QStringList names;
+    const QStringList files = QDir(directory).entryList({"*" + Suffix}, QDir::Files, QDir::Name);
+    for (const QString& file : files) {
+        QString base = file.chopped(Suffix.size());
+        QString key = base == ServerFile ? QString() : QUrl::fromPercentEncoding(base.toUtf8());
+        // File names are folded; the lines keep the buffer's own spelling
+        const auto last = lines(key, 1);
+        names << (last.isEmpty() ? key : last.first().buffer);
+    }
+    return names;
+}
+
+QVector<ScrollbackLine> History::lines(const QString& buffer, int limit) const {
+    QVector<ScrollbackLine> result;
+    QFile file(pathFor(buffer));
+    if (limit <= 0 || !file.open(QIODevice::ReadOnly)) return result;
+
+    // Walk back over the length trailers; anything that does not add up,
+    // such as a record torn by a crash, ends the walk
+    qint64 pos = file.size();
+    while (pos >= qint64(sizeof(quint32)) && result.size() < limit) {
+        quint32 size = 0;
+        pos -= sizeof(size);
+        if (!file.seek(pos) || file.read(reinterpret_cast<char*>(&size), sizeof(size)) != sizeof(size)) break;
+        size = qFromBigEndian(size);
+        if (size > pos) break;
+        pos -= size;
+        if (!file.seek(pos)) break;
+
+        QDataStream in(file.read(size));
+        in.setVersion(QDataStream::Qt_5_15);
+        ScrollbackLine line;
+        in >> line;
+        if (in.status() != QDataStream::Ok) break;
+        result.append(line);
+    }
+    std::reverse(result.begin(), result.end());
+
+    // Only orders this window; the file itself stays in import order
+    std::stable_sort(result.begin(), result.end(), [](const ScrollbackLine& a, const ScrollbackLine& b) {
+        return a.timestamp < b.timestamp;
+    });
+    return result;
+}
+
+History::Progress History::progress(const QString& source) const {
+    loadSources();
+    return sources.value(source);
+}
+
+void History::setProgress(const QString& source, const Progress& progress) {
+    loadSources();
+    sources.insert(source, progress);
+    sourcesChanged = true;
+}
+
+bool History::saveProgress() {
+    if (!sourcesChanged) return true;
+
+    // Rewritten whole and swapped in, so a crash keeps the previous state
+    QSaveFile file(sourcesPath());
+    if (QDir().mkpath(directory) && file.open(QIODevice::WriteOnly)) {
+        QDataStream out(&file);
+        out.setVersion(QDataStream::Qt_5_15);
+        out << quint32(sources.size());
+        for (auto it = sources.cbegin(); it != sources.cend(); ++it) {
+            out << it.key() << it->offset << it->day;
+        }
+        if (file.commit()) {
+            sourcesChanged = false;
+            return true;
+        }
+    }
+    lastError = QString("Cannot write %1: %2").arg(sourcesPath(), file.errorString());
+    qWarning().noquote() << lastError;
+    return false;
+}
+
+void History::loadSources() const {
+    if (sourcesLoaded) return;
+    sourcesLoaded = true;
+
+    QFile file(sourcesPath());
+    if (!file.open(QIODevice::ReadOnly)) return;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        QString source;
+        Progress progress;
+        in >> source >> progress.offset >> progress.day;
+        if (in.status() == QDataStream::Ok) sources.insert(source, progress);
+    }
+}
+
+QString History::pathFor(const QString& buffer) const {
+    QString key = buffer.toLower();
+    QString base = key.isEmpty() ? ServerFile : QString::fromLatin1(QUrl::toPercentEncoding(key, QByteArray(), "-"));
+    return directory + '/' + base + Suffix;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <QDate>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "scrollback.h"
+
+// Imported log history, kept on disk apart from the in-memory scrollback
+// so it is not bound by the ring capacity; nothing is ever trimmed. Each
+// buffer is an append-only file of records, each followed by its length
+// so the tail can be read backwards without scanning the whole file.
+// How far each log file has been imported is recorded as well, so
+// importing the same logs again only adds what was not there yet.
+class History {
+public:
+    struct Progress {
+        qint64 offset = 0;  // bytes of the log file already imported
+        QDate day;          // the day in effect at that offset
+    };
+
+    explicit History(const QString& directory = defaultDirectory());
+    static QString defaultDirectory();
+
+    // Streams a batch to the end of each buffer's file
+    bool append(const QVector<ScrollbackLine>& lines);
+    bool contains(const QString& buffer) const;
+    QStringList buffers() const;
+    // The last limit records in import order, sorted by time among
+    // themselves. Logs imported after newer ones therefore come last.
+    QVector<ScrollbackLine> lines(const QString& buffer, int limit) const;
+
+    Progress progress(const QString& source) const;
+    void setProgress(const QString& source, const Progress& progress);
+    bool saveProgress();
+    QString errorString() const { return lastError; }
+
+private:
+    QString directory;
+    QString lastError;
+    mutable QHash<QString, Progress> sources;
+    mutable bool sourcesLoaded = false;
+    bool sourcesChanged = false;
+
+    QString pathFor(const QString& buffer) const;
+    QString sourcesPath() const { return directory + "/sources.idx"; }
+    void loadSources() const;
+};
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "log_import.h"
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QThread>
+#include <cstring>
+
+namespace {
+
+const qint64 ChunkSize = 4 * 1024 * 1024;
+const int ProgressSaveInterval = 1000;  // ms between saving how far each file got
+const QString ModeSymbols = "~&@%+!";
+
+LogImporter::Format sniffFormat(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return LogImporter::Unknown;
+
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine(4096)).trimmed();
+        if (line.isEmpty()) continue;
+        if (QRegularExpression("^\\d{4}-\\d{2}-\\d{2} \\d{2}:\\d{2}:\\d{2}\\t").match(line).hasMatch()) {
+            return LogImporter::Weechat;
+        }
+        if (QRegularExpression("^\\[\\d{2}:\\d{2}(:\\d{2})?\\] ").match(line).hasMatch()) {
+            return LogImporter::Znc;
+        }
+        if (line.startsWith("--- Log opened") || QRegularExpression("^\\d{2}:\\d{2}(:\\d{2})? ").match(line).hasMatch()) {
+            return LogImporter::Irssi;
+        }
+        return LogImporter::Unknown;
+    }
+    return LogImporter::Unknown;
+}
+
+// irc.libera.#chan.weechatlog, #chan.log, network_#chan_20190101.log
+// or ZNC's newer network/#chan/2019-01-01.log layout
+QString bufferName(const QFileInfo& info, LogImporter::Format format, QDate& date) {
+    QString base = info.completeBaseName();
+    if (format == LogImporter::Weechat) {
+        if (base.startsWith("irc.")) base = base.mid(4);
+        if (base.startsWith("server.")) return QString();
+        return base.section('.', 1);
+    }
+    if (format == LogImporter::Znc) {
+        QDate named = QDate::fromString(base, "yyyy-MM-dd");
+        if (named.isValid()) {
+            date = named;
+            return info.dir().dirName();
+        }
+        named = QDate::fromString(base.section('_', -1), "yyyyMMdd");
+        if (named.isValid()) {
+            date = named;
+            return base.section('_', -2, -2);
+        }
+    }
+    return base;
+}
+
+int number(const QString& text, int pos, int length) {
+    int value = 0;
+    for (int i = pos; i < pos + length; i++) {
+        if (i >= text.size()) return -1;
+        int digit = text.at(i).unicode() - '0';
+        if (digit < 0 || digit > 9) return -1;
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+// HH:MM or HH:MM:SS at pos; end is left on the character after it
+int parseClock(const QString& text, int pos, int& end) {
+    int hours = number(text, pos, 2);
+    int minutes = number(text, pos + 3, 2);
+    if (hours < 0 || minutes < 0 || text.at(pos + 2) != ':') return -1;
+    int seconds = 0;
+    end = pos + 5;
+    if (end < text.size() && text.at(end) == ':') {
+        seconds = number(text, end + 1, 2);
+        if (seconds < 0) return -1;
+        end += 3;
+    }
+    return ((hours * 60 + minutes) * 60 + seconds) * 1000;
+}
+
+QDate parseIrssiDate(const QString& text) {
+    // "Tue Jan 01 00:00:00 2019" or "Wed Jan 02 2019"
+    static const QStringList months = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                       "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    QStringList words = text.split(' ', Qt::SkipEmptyParts);
+    if (words.size() < 4) return QDate();
+    return QDate(words.last().toInt(), months.indexOf(words.at(1)) + 1, words.at(2).toInt());
+}
+
+QString stripModes(const QString& nick) {
+    int i = 0;
+    while (i < nick.size() - 1 && (nick.at(i) == ' ' || ModeSymbols.contains(nick.at(i)))) i++;
+    return nick.mid(i);
+}
+
+// "nick does something" -> nick, "does something"
+void splitFirstWord(const QString& text, QString& first, QString& rest) {
+    int space = text.indexOf(' ');
+    first = space < 0 ? text : text.left(space);
+    rest = space < 0 ? QString() : text.mid(space + 1);
+}
+
+}
+
+LogImporter::LogImporter(History* history, QObject* parent)
+    : QObject(parent), history(history), pollTimer(new QTimer(this)) {
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    pollTimer->setInterval(100);
+    connect(pollTimer, &QTimer::timeout, this, &LogImporter::poll);
+}
+
+LogImporter::~LogImporter() {
+    cancelled = 1;
+    pool.waitForDone();
+    qDeleteAll(chunks);
+}
+
+bool LogImporter::start(const QStringList& paths) {
+    if (running) return false;
+
+    sources.clear();
+    errors.clear();
+    for (const QString& path : paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QDirIterator it(path, {"*.log", "*.weechatlog"}, QDir::Files, QDirIterator::Subdirectories);
+            QStringList files;
+            while (it.hasNext()) files << it.next();
+            // Date-named files sort into chronological order
+            files.sort();
+            for (const QString& file : qAsConst(files)) addSource(file);
+        } else if (info.isFile()) {
+            addSource(path);
+        } else {
+            errors << QString("%1: no such file or directory").arg(path);
+        }
+    }
+
+    currentDays.clear();
+    totalBytes = 0;
+    for (int i = 0; i < sources.size(); i++) {
+        // Pick up where an earlier import of this file stopped; a file
+        // that is now shorter was replaced and is read from the start
+        Source& source = sources[i];
+        History::Progress done = history->progress(source.path);
+        if (done.offset <= source.size) {
+            source.offset = done.offset;
+            if (done.day.isValid()) source.date = done.day;
+        }
+        currentDays << source.date;
+
+        totalBytes += source.size - source.offset;
+        for (qint64 begin = source.offset; begin < source.size; begin += ChunkSize) {
+            auto chunk = new Chunk;
+            chunk->source = i;
+            chunk->begin = begin;
+            chunk->end = qMin(begin + ChunkSize, source.size);
+            chunks.append(chunk);
+        }
+    }
+
+    nextChunk = 0;
+    nextQueued = 0;
+    imported = 0;
+    cancelled = 0;
+    parsedBytes = 0;
+    pending = 0;
+    running = true;
+    writeFailed = false;
+    sinceSave.start();
+    qDebug() << "Importing" << sources.size() << "log files," << totalBytes << "bytes in"
+             << chunks.size() << "chunks";
+
+    queueChunks();
+    pollTimer->start();
+    poll();
+    return true;
+}
+
+void LogImporter::cancel() {
+    // Queued chunks see the flag and return straight away, the rest never start
+    if (running) cancelled = 1;
+}
+
+void LogImporter::poll() {
+    if (!running) return;
+
+    while (nextChunk < chunks.size() && chunks.at(nextChunk)->done.loadAcquire()) {
+        Chunk* chunk = chunks.at(nextChunk);
+        if (!cancelled.loadRelaxed()) deliver(chunk);
+        chunks[nextChunk++] = nullptr;
+        delete chunk;
+    }
+    queueChunks();
+    if (sinceSave.elapsed() > ProgressSaveInterval) saveProgress();
+    emit progress(parsedBytes.loadRelaxed(), totalBytes);
+
+    if (nextChunk == chunks.size() || (cancelled.loadRelaxed() && pending.loadAcquire() == 0)) finish();
+}
+
+void LogImporter::queueChunks() {
+    if (cancelled.loadRelaxed()) return;
+
+    int window = 2 * qMax(1, pool.maxThreadCount());
+    while (nextQueued < chunks.size() && nextQueued - nextChunk < window) {
+        Chunk* chunk = chunks.at(nextQueued++);
+        const Source& source = sources.at(chunk->source);
+        pending.fetchAndAddOrdered(1);
+        pool.start(QRunnable::create([this, chunk, source]() {
+            parseChunk(chunk, source, cancelled);
+            parsedBytes.fetchAndAddRelaxed(chunk->end - chunk->begin);
+            chunk->done = 1;
+            pending.fetchAndAddOrdered(-1);
+            // Deliver and refill right away rather than on the next tick
+            QMetaObject::invokeMethod(this, &LogImporter::poll, Qt::QueuedConnection);
+        }));
+    }
+}
+
+void LogImporter::addSource(const QString& path) {
+    QFileInfo info(path);
+    Source source;
+    source.path = info.canonicalFilePath();
+    source.size = info.size();
+    source.format = sniffFormat(path);
+    if (source.format == Unknown) {
+        if (source.size > 0) qDebug() << "Skipping unrecognised log" << path;
+        return;
+    }
+    source.date = info.lastModified().date();
+    source.buffer = bufferName(info, source.format, source.date);
+    sources.append(source);
+}
+
+void LogImporter::deliver(Chunk* chunk) {
+    if (!chunk->error.isEmpty()) errors << chunk->error;
+
+    // Only now, in file order, is the day known for logs that carry times only
+    QDate& day = currentDays[chunk->source];
+    int marker = 0;
+    for (int i = 0; i < chunk->lines.size(); i++) {
+        while (marker < chunk->days.size() && chunk->days.at(marker).first <= i) {
+            day = chunk->days.at(marker++).second;
+        }
+        int msecs = chunk->times.at(i);
+        if (msecs >= 0) chunk->lines[i].timestamp = QDateTime(day, QTime::fromMSecsSinceStartOfDay(msecs));
+    }
+    if (!chunk->days.isEmpty()) day = chunk->days.last().second;
+
+    Source& source = sources[chunk->source];
+    if (!chunk->error.isEmpty()) source.failed = true;
+    if (!history->append(chunk->lines)) {
+        errors << history->errorString();
+        writeFailed = true;
+        cancelled = 1;
+        return;
+    }
+    imported += chunk->lines.size();
+    if (!source.failed) history->setProgress(source.path, {chunk->end, day});
+}
+
+void LogImporter::saveProgress() {
+    // Saved after the lines it covers, so a crash can only repeat lines
+    if (!history->saveProgress()) {
+        errors << history->errorString();
+        writeFailed = true;
+        cancelled = 1;
+    }
+    sinceSave.restart();
+}
+
+void LogImporter::finish() {
+    pollTimer->stop();
+    pool.waitForDone();
+    saveProgress();
+    qDeleteAll(chunks);
+    chunks.clear();
+    running = false;
+
+    QString error = cancelled.loadRelaxed() && !writeFailed ? QString("Import cancelled") : errors.join('\n');
+    qDebug() << "Imported" << imported << "lines from" << sources.size() << "log files";
+    emit progress(totalBytes, totalBytes);
+    emit finished(imported, error);
+}
+
+void LogImporter::parseChunk(Chunk* chunk, const Source& source, const QAtomicInt& cancelled) {
+    if (cancelled.loadRelaxed()) return;
+
+    QFile file(source.path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        chunk->error = QString("%1: %2").arg(source.path, file.errorString());
+        return;
+    }
+
+    // Map one byte early to see whether the chunk starts on a line, and on
+    // to the end of the file so the last line can run past the chunk
+    qint64 mapStart = qMax<qint64>(0, chunk->begin - 1);
+    qint64 mapSize = source.size - mapStart;
+    const char* data = reinterpret_cast<const char*>(file.map(mapStart, mapSize));
+    if (!data) {
+        chunk->error = QString("%1: %2").arg(source.path, file.errorString());
+        return;
+    }
+    const char* limit = data + mapSize;
+    const char* pos = data + (chunk->begin - mapStart);
+    const char* end = data + (chunk->end - mapStart);
+
+    // A line belongs to the chunk its first byte falls in
+    if (chunk->begin > 0 && data[0] != '\n') {
+        auto newline = static_cast<const char*>(memchr(pos, '\n', limit - pos));
+        pos = newline ? newline + 1 : limit;
+    }
+
+    chunk->lines.reserve(int((chunk->end - chunk->begin) / 80));
+    chunk->times.reserve(chunk->lines.capacity());
+
+    int count = 0;
+    while (pos < end) {
+        if (++count % 4096 == 0 && cancelled.loadRelaxed()) break;
+
+        auto newline = static_cast<const char*>(memchr(pos, '\n', limit - pos));
+        const char* lineEnd = newline ? newline : limit;
+        int length = int(lineEnd - pos);
+        if (length > 0 && pos[length - 1] == '\r') length--;
+        QString text = QString::fromUtf8(pos, length);
+        pos = newline ? newline + 1 : limit;
+        if (text.isEmpty()) continue;
+
+        ScrollbackLine line;
+        line.buffer = source.buffer;
+        int msecs = -1;
+        int after = 0;
+        QString rest;
+
+        if (source.format == Irssi) {
+            if (text.startsWith("--- Log opened ") || text.startsWith("--- Day changed ")) {
+                QDate date = parseIrssiDate(text.mid(text.indexOf(' ', 8) + 1));
+                if (date.isValid()) chunk->days.append({chunk->lines.size(), date});
+                continue;
+            }
+            if (text.size() < 6 || (msecs = parseClock(text, 0, after)) < 0) continue;
+            rest = text.mid(after + 1);
+
+            if (rest.startsWith('<')) {
+                int close = rest.indexOf("> ");
+                if (close < 0) continue;
+                line.kind = ScrollbackLine::Message;
+                line.nick = stripModes(rest.mid(1, close - 1));
+                line.text = rest.mid(close + 2);
+            } else if (rest.startsWith(" * ")) {
+                line.kind = ScrollbackLine::Action;
+                splitFirstWord(rest.mid(3), line.nick, line.text);
+            } else if (rest.startsWith("-!- ")) {
+                line.text = rest.mid(4);
+                line.nick = line.text.section(' ', 0, 0);
+            } else if (rest.startsWith('-') && rest.indexOf("- ") > 1) {
+                // -nick(user@host)- or -nick:#chan-
+                int close = rest.indexOf("- ");
+                line.kind = ScrollbackLine::Notice;
+                line.nick = rest.mid(1, close - 1);
+                int cut = line.nick.indexOf(line.nick.contains('(') ? '(' : ':');
+                if (cut > 0) line.nick.truncate(cut);
+                line.text = rest.mid(close + 2);
+            } else {
+                line.text = rest;
+            }
+        }
+        else if (source.format == Znc) {
+            if (!text.startsWith('[') || (msecs = parseClock(text, 1, after)) < 0) continue;
+            if (after + 1 >= text.size() || text.at(after) != ']') continue;
+            rest = text.mid(after + 2);
+
+            if (rest.startsWith('<')) {
+                int close = rest.indexOf("> ");
+                if (close < 0) continue;
+                line.kind = ScrollbackLine::Message;
+                line.nick = stripModes(rest.mid(1, close - 1));
+                line.text = rest.mid(close + 2);
+            } else if (rest.startsWith("*** ")) {
+                line.text = rest.mid(4);
+            } else if (rest.startsWith("* ")) {
+                line.kind = ScrollbackLine::Action;
+                splitFirstWord(rest.mid(2), line.nick, line.text);
+            } else if (rest.startsWith('-') && rest.indexOf("- ") > 1) {
+                int close = rest.indexOf("- ");
+                line.kind = ScrollbackLine::Notice;
+                line.nick = rest.mid(1, close - 1);
+                line.text = rest.mid(close + 2);
+            } else {
+                line.text = rest;
+            }
+        }
+        else {
+            // 2019-01-01 12:34:56<TAB>prefix<TAB>message
+            int year = number(text, 0, 4);
+            int month = number(text, 5, 2);
+            int day = number(text, 8, 2);
+            int clock = text.size() > 19 ? parseClock(text, 11, after) : -1;
+            int tab = text.indexOf('\t', 19);
+            int tab2 = tab < 0 ? -1 : text.indexOf('\t', tab + 1);
+            if (year < 0 || month < 0 || day < 0 || clock < 0 || tab2 < 0) continue;
+            line.timestamp = QDateTime(QDate(year, month, day), QTime::fromMSecsSinceStartOfDay(clock));
+
+            QString prefix = text.mid(tab + 1, tab2 - tab - 1);
+            rest = text.mid(tab2 + 1);
+            if (prefix.isEmpty() || prefix == "-->" || prefix == "<--" || prefix == "--") {
+                line.text = rest;
+                if (prefix != "--") line.nick = rest.section(' ', 0, 0);
+            } else if (prefix.trimmed() == "*") {
+                line.kind = ScrollbackLine::Action;
+                splitFirstWord(rest, line.nick, line.text);
+            } else {
+                line.kind = ScrollbackLine::Message;
+                line.nick = stripModes(prefix);
+                line.text = rest;
+            }
+        }
+
+        if (msecs >= 0 && source.format == Znc) {
+            line.timestamp = QDateTime(source.date, QTime::fromMSecsSinceStartOfDay(msecs));
+            msecs = -1;
+        }
+        chunk->lines.append(line);
+        chunk->times.append(msecs);
+    }
+}
\ No newline at end of file
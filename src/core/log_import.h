@@ -0,0 +1,84 @@
+#pragma once
+#include <QObject>
+#include <QAtomicInt>
+#include <QDate>
+#include <QElapsedTimer>
+#include <QPair>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+#include "history.h"
+
+// Imports irssi, weechat and ZNC text logs. Files are cut into fixed-size
+// chunks that are memory-mapped and parsed on a thread pool; finished
+// chunks are handed out in file order from the owning thread. Only a few
+// chunks per thread are queued at once, so parsed lines waiting behind a
+// slow chunk cannot pile up without bound. Lines are written straight to
+// the history, and whatever it already holds from a file is skipped.
+class LogImporter : public QObject {
+    Q_OBJECT
+public:
+    enum Format { Unknown, Irssi, Weechat, Znc };
+
+    explicit LogImporter(History* history, QObject* parent = nullptr);
+    ~LogImporter() override;
+
+    // Files or directories to search for logs; false if already running
+    bool start(const QStringList& paths);
+    void cancel();
+    bool isRunning() const { return running; }
+
+signals:
+    void progress(qint64 done, qint64 total);
+    void finished(qint64 lines, const QString& error);
+
+private slots:
+    void poll();
+
+private:
+    struct Source {
+        QString path;       // canonical, so the same file is recognised again
+        Format format = Unknown;
+        QString buffer;
+        QDate date;         // from the file name, or its mtime as a fallback
+        qint64 size = 0;
+        qint64 offset = 0;  // where this run starts, past what was imported before
+        bool failed = false;    // a chunk could not be read, so stop recording progress
+    };
+
+    struct Chunk {
+        int source = 0;
+        qint64 begin = 0;
+        qint64 end = 0;
+        QVector<ScrollbackLine> lines;
+        QVector<int> times;                 // msecs since midnight when the date comes later
+        QVector<QPair<int, QDate>> days;    // date changes, by index of the next line
+        QString error;
+        QAtomicInt done;
+    };
+
+    History* history;
+    QThreadPool pool;
+    QTimer* pollTimer;
+    QVector<Source> sources;
+    QElapsedTimer sinceSave;
+    QVector<Chunk*> chunks;
+    QVector<QDate> currentDays;
+    QStringList errors;
+    int nextChunk = 0;      // next to deliver
+    int nextQueued = 0;     // next to hand to the pool
+    qint64 totalBytes = 0;
+    qint64 imported = 0;
+    bool running = false;
+    bool writeFailed = false;
+    QAtomicInt cancelled;
+    QAtomicInt pending;
+    QAtomicInteger<qint64> parsedBytes;
+
+    void addSource(const QString& path);
+    void queueChunks();
+    void deliver(Chunk* chunk);
+    void finish();
+    void saveProgress();
+    static void parseChunk(Chunk* chunk, const Source& source, const QAtomicInt& cancelled);
+};
\ No newline at end of file
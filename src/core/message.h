@@ -9,6 +9,7 @@ struct IrcMessage {
     QString trailing;
     QString raw;
     QDateTime timestamp;
+    bool highlighted = false;
     
     static IrcMessage parse(const QString& raw);
     QString nickname() const;
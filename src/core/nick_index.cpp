@@ -0,0 +1,101 @@
+#include "nick_index.h"
+#include "state.h"
+#include <QSet>
+#include <algorithm>
+
+void NickIndex::setUsers(const QString& channel, const QStringList& nicks) {
+    channels[keyFor(channel)].sorted = sortedEntries(nicks);
+}
+
+void NickIndex::addUser(const QString& channel, const QString& nick) {
+    Channel& chan = channels[keyFor(channel)];
+    Entry entry{keyFor(nick), nick};
+    auto it = std::lower_bound(chan.sorted.begin(), chan.sorted.end(), entry);
+    if (it != chan.sorted.end() && it->key == entry.key) {
+        it->nick = nick;
+        return;
+    }
+    chan.sorted.insert(it, entry);
+}
+
+void NickIndex::removeUser(const QString& channel, const QString& nick) {
+    auto chanIt = channels.find(keyFor(channel));
+    if (chanIt == channels.end()) return;
+
+    Entry entry{keyFor(nick), nick};
+    auto it = std::lower_bound(chanIt->sorted.begin(), chanIt->sorted.end(), entry);
+    if (it != chanIt->sorted.end() && it->key == entry.key) {
+        chanIt->sorted.erase(it);
+    }
+    chanIt->recent.removeAll(entry.key);
+}
+
+void NickIndex::clearChannel(const QString& channel) {
+    channels.remove(keyFor(channel));
+}
+
+void NickIndex::clear() {
+    channels.clear();
+    channelNames.clear();
+}
+
+void NickIndex::setChannels(const QStringList& names) {
+    channelNames = sortedEntries(names);
+}
+
+void NickIndex::touch(const QString& channel, const QString& nick) {
+    Channel& chan = channels[keyFor(channel)];
+    QString key = keyFor(nick);
+    chan.recent.removeOne(key);
+    chan.recent.prepend(key);
+    if (chan.recent.size() > MaxRecent) chan.recent.removeLast();
+}
+
+QStringList NickIndex::complete(const QString& channel, const QString& prefix, int limit) const {
+    QStringList result;
+    Entry probe{keyFor(prefix), QString()};
+
+    auto chanIt = channels.constFind(keyFor(channel));
+    if (chanIt != channels.constEnd()) {
+        const QVector<Entry>& sorted = chanIt->sorted;
+        auto begin = std::lower_bound(sorted.cbegin(), sorted.cend(), probe);
+
+        // Recent speakers who are still in the channel go first
+        QSet<QString> taken;
+        for (const QString& key : chanIt->recent) {
+            if (result.size() >= limit) break;
+            if (!key.startsWith(probe.key)) continue;
+            auto it = std::lower_bound(begin, sorted.cend(), Entry{key, QString()});
+            if (it == sorted.cend() || it->key != key) continue;
+            result << it->nick;
+            taken.insert(key);
+        }
+
+        for (auto it = begin; it != sorted.cend() && result.size() < limit; ++it) {
+            if (!it->key.startsWith(probe.key)) break;
+            if (!taken.contains(it->key)) result << it->nick;
+        }
+    }
+
+    auto it = std::lower_bound(channelNames.cbegin(), channelNames.cend(), probe);
+    for (; it != channelNames.cend() && result.size() < limit; ++it) {
+        if (!it->key.startsWith(probe.key)) break;
+        result << it->nick;
+    }
+    return result;
+}
+
+QString NickIndex::keyFor(const QString& name) const {
+    return ircState ? ircState->fold(name) : name.toLower();
+}
+
+QVector<NickIndex::Entry> NickIndex::sortedEntries(const QStringList& names) const {
+    QVector<Entry> entries;
+    entries.reserve(names.size());
+    for (const QString& name : names) entries.append({keyFor(name), name});
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const Entry& a, const Entry& b) { return a.key == b.key; }),
+                  entries.end());
+    return entries;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+class IrcState;
+
+// Per-channel sorted nick index for tab completion. Membership changes
+// are applied incrementally and lookups are a binary search on the
+// case-folded prefix, so completing in very large channels stays cheap.
+class NickIndex {
+public:
+    // Keys follow the server's CASEMAPPING once a state is set
+    void setState(const IrcState* state) { ircState = state; }
+
+    void setUsers(const QString& channel, const QStringList& nicks);
+    void addUser(const QString& channel, const QString& nick);
+    void removeUser(const QString& channel, const QString& nick);
+    void clearChannel(const QString& channel);
+    void clear();
+
+    // Joined channels, offered after the nicks
+    void setChannels(const QStringList& names);
+
+    // Marks a nick as having just spoken so it completes first
+    void touch(const QString& channel, const QString& nick);
+
+    // Recent speakers first (most recent first), then alphabetical, then channels
+    QStringList complete(const QString& channel, const QString& prefix, int limit = 50) const;
+
+private:
+    struct Entry {
+        QString key;
+        QString nick;
+        bool operator<(const Entry& other) const { return key < other.key; }
+    };
+
+    struct Channel {
+        QVector<Entry> sorted;
+        QStringList recent;
+    };
+
+    static const int MaxRecent = 64;
+
+    const IrcState* ircState = nullptr;
+    QHash<QString, Channel> channels;
+    QVector<Entry> channelNames;
+
+    QString keyFor(const QString& name) const;
+    QVector<Entry> sortedEntries(const QStringList& names) const;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <QtPlugin>
+#include <QStringList>
+#include "message.h"
+#include "state.h"
+
+// What a plugin may call back into. Calls are made on the thread that owns
+// the IrcClient: the GUI thread when running standalone, the main thread
+// of a --core.
+class PluginHost {
+public:
+    virtual ~PluginHost() = default;
+
+    // Sends a raw line (without CRLF). It passes the outgoing hooks of every
+    // plugin except those whose hook is currently running, including the caller's
+    virtual void sendRaw(const QString& line) = 0;
+    virtual QString nickname() const = 0;
+    virtual const IrcState* state() const = 0;
+};
+
+// Interface for native plugins loaded with QPluginLoader. Hooks run only
+// for the commands a plugin subscribes to, so a plugin pays nothing for
+// traffic it does not ask for. There is no separate network thread: hooks
+// run on the IrcClient's thread, so a slow hook stalls the UI when running
+// standalone. PING is shown to hooks but always answered.
+class ComSockPlugin {
+public:
+    virtual ~ComSockPlugin() = default;
+
+    virtual QString name() const = 0;
+    virtual void initialize(PluginHost* host) = 0;
+
+    // Commands to hook, e.g. "PRIVMSG", "JOIN" or "001"; "*" for all
+    virtual QStringList incomingCommands() const { return QStringList(); }
+    virtual QStringList outgoingCommands() const { return QStringList(); }
+
+    // Return false to drop the message as if it never arrived or was sent
+    virtual bool incoming(const IrcMessage& message) { Q_UNUSED(message); return true; }
+    virtual bool outgoing(const IrcMessage& message) { Q_UNUSED(message); return true; }
+};
+
+#define ComSockPlugin_iid "org.comsock.ComSockPlugin/1.0"
+Q_DECLARE_INTERFACE(ComSockPlugin, ComSockPlugin_iid)
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "plugins.h"
+#include "client.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QLibrary>
+#include <QPluginLoader>
+#include <QStandardPaths>
+
+namespace {
+
+const qint64 SlowHookNsecs = 1000000;  // 1 ms
+
+}
+
+PluginManager::PluginManager(IrcClient* client, QObject* parent) : QObject(parent), client(client) {
+}
+
+PluginManager::~PluginManager() {
+    qDeleteAll(entries);
+}
+
+void PluginManager::loadPlugins() {
+    QStringList dirs;
+    dirs << QCoreApplication::applicationDirPath() + "/plugins";
+    dirs << QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/plugins";
+
+    for (const QString& dirPath : dirs) {
+        QDir dir(dirPath);
+        for (const QString& file : dir.entryList(QDir::Files)) {
+            QString path = dir.absoluteFilePath(file);
+            if (QLibrary::isLibrary(path)) loadPlugin(path);
+        }
+    }
+}
+
+bool PluginManager::loadPlugin(const QString& path) {
+    auto loader = new QPluginLoader(path, this);
+    auto plugin = qobject_cast<ComSockPlugin*>(loader->instance());
+    if (!plugin) {
+        qWarning() << "Not a ComSock plugin:" << path << loader->errorString();
+        delete loader;
+        return false;
+    }
+
+    auto entry = new Entry;
+    entry->loader = loader;
+    entry->plugin = plugin;
+    entry->name = plugin->name();
+    entries.append(entry);
+
+    plugin->initialize(this);
+    for (const QString& command : plugin->incomingCommands()) {
+        incomingHooks[command.toUpper()].append(entry);
+    }
+    for (const QString& command : plugin->outgoingCommands()) {
+        outgoingHooks[command.toUpper()].append(entry);
+    }
+
+    qDebug() << "Loaded plugin" << entry->name << "from" << path;
+    return true;
+}
+
+QStringList PluginManager::pluginNames() const {
+    QStringList names;
+    for (const Entry* entry : entries) names << entry->name;
+    return names;
+}
+
+QString PluginManager::report() const {
+    if (entries.isEmpty()) return tr("No plugins loaded");
+
+    QStringList lines;
+    for (const Entry* entry : entries) {
+        double average = entry->calls ? entry->totalNsecs / 1000.0 / entry->calls : 0.0;
+        lines << tr("%1: %2 calls, %3 us average, %4 us max")
+            .arg(entry->name)
+            .arg(entry->calls)
+            .arg(average, 0, 'f', 1)
+            .arg(entry->maxNsecs / 1000.0, 0, 'f', 1);
+    }
+    return lines.join('\n');
+}
+
+bool PluginManager::dispatchIncoming(const IrcMessage& message) {
+    if (incomingHooks.isEmpty()) return true;
+    return dispatch(incomingHooks, message.command.toUpper(), message, true);
+}
+
+bool PluginManager::dispatchOutgoing(const QString& line) {
+    if (outgoingHooks.isEmpty()) return true;
+
+    // Only parse the line if somebody actually wants to see it
+    QString command = line.section(' ', 0, 0).toUpper();
+    if (!outgoingHooks.contains(command) && !outgoingHooks.contains("*")) return true;
+    return dispatch(outgoingHooks, command, IrcMessage::parse(line), false);
+}
+
+void PluginManager::sendRaw(const QString& line) {
+    client->sendRaw(line);
+}
+
+QString PluginManager::nickname() const {
+    return client->nickname();
+}
+
+const IrcState* PluginManager::state() const {
+    return client->state();
+}
+
+bool PluginManager::dispatch(const HookTable& hooks, const QString& command,
+                             const IrcMessage& message, bool incoming) {
+    auto specific = hooks.constFind(command);
+    if (specific != hooks.constEnd()) {
+        for (Entry* entry : *specific) {
+            if (running.contains(entry)) continue;
+            if (!runHook(entry, message, incoming)) return false;
+        }
+    }
+    auto all = hooks.constFind("*");
+    if (all != hooks.constEnd()) {
+        for (Entry* entry : *all) {
+            // A plugin subscribed to both the command and "*" sees it once
+            if (running.contains(entry)) continue;
+            if (specific != hooks.constEnd() && specific->contains(entry)) continue;
+            if (!runHook(entry, message, incoming)) return false;
+        }
+    }
+    return true;
+}
+
+bool PluginManager::runHook(Entry* entry, const IrcMessage& message, bool incoming) {
+    QElapsedTimer timer;
+    timer.start();
+    // Lines a hook injects through sendRaw() must not re-enter that same hook
+    running.append(entry);
+    bool keep = incoming ? entry->plugin->incoming(message) : entry->plugin->outgoing(message);
+    running.removeLast();
+    qint64 elapsed = timer.nsecsElapsed();
+
+    entry->calls++;
+    entry->totalNsecs += elapsed;
+    entry->maxNsecs = qMax(entry->maxNsecs, elapsed);
+    if (elapsed > SlowHookNsecs) {
+        qWarning() << "Slow plugin hook:" << entry->name << message.command
+                   << elapsed / 1000 << "us";
+        emit slowHook(entry->name, message.command, elapsed);
+    }
+    return keep;
+}
\ No newline at end of file
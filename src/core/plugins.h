@@ -0,0 +1,54 @@
+#pragma once
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include "plugin.h"
+
+class IrcClient;
+class QPluginLoader;
+
+class PluginManager : public QObject, public PluginHost {
+    Q_OBJECT
+public:
+    explicit PluginManager(IrcClient* client, QObject* parent = nullptr);
+    ~PluginManager() override;
+
+    void loadPlugins();
+    bool loadPlugin(const QString& path);
+    QStringList pluginNames() const;
+    QString report() const;
+
+    // Both return false when a plugin suppressed the message
+    bool dispatchIncoming(const IrcMessage& message);
+    bool dispatchOutgoing(const QString& line);
+
+    // PluginHost
+    void sendRaw(const QString& line) override;
+    QString nickname() const override;
+    const IrcState* state() const override;
+
+signals:
+    void slowHook(const QString& plugin, const QString& command, qint64 nsecs);
+
+private:
+    struct Entry {
+        QPluginLoader* loader = nullptr;
+        ComSockPlugin* plugin = nullptr;
+        QString name;
+        qint64 calls = 0;
+        qint64 totalNsecs = 0;
+        qint64 maxNsecs = 0;
+    };
+
+    typedef QHash<QString, QVector<Entry*>> HookTable;
+
+    IrcClient* client;
+    QVector<Entry*> entries;
+    HookTable incomingHooks;
+    HookTable outgoingHooks;
+    QVector<Entry*> running;  // hooks on the call stack, skipped by re-entrant dispatch
+
+    bool dispatch(const HookTable& hooks, const QString& command,
+                  const IrcMessage& message, bool incoming);
+    bool runHook(Entry* entry, const IrcMessage& message, bool incoming);
+};
\ No newline at end of file
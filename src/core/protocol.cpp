@@ -0,0 +1,53 @@
+#include "protocol.h"
+#include <QIODevice>
+#include <QtEndian>
+
+namespace CoreProtocol {
+
+QString socketName() {
+    QString user = qEnvironmentVariable("USER", qEnvironmentVariable("USERNAME"));
+    return user.isEmpty() ? QString("comsock-core") : QString("comsock-core-%1").arg(user);
+}
+
+void writeFrame(QIODevice* device, Type type, const QByteArray& payload) {
+    QByteArray frame;
+    frame.reserve(5 + payload.size());
+    quint32 length = qToBigEndian(quint32(payload.size() + 1));
+    frame.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    frame.append(char(type));
+    frame.append(payload);
+    device->write(frame);
+}
+
+bool takeFrame(QByteArray& buffer, Type& type, QByteArray& payload) {
+    if (buffer.size() < 5) return false;
+    quint32 length = qFromBigEndian<quint32>(buffer.constData());
+    if (length == 0) {
+        // Not a frame we ever send; skip the bogus header
+        buffer.remove(0, 4);
+        return takeFrame(buffer, type, payload);
+    }
+    if (quint32(buffer.size()) < 4 + length) return false;
+
+    type = Type(quint8(buffer.at(4)));
+    payload = buffer.mid(5, length - 1);
+    buffer.remove(0, 4 + length);
+    return true;
+}
+
+}
+
+QDataStream& operator<<(QDataStream& out, const ScrollbackLine& line) {
+    out << line.seq << line.timestamp.toMSecsSinceEpoch() << line.buffer << line.nick
+        << line.text << quint8(line.kind) << line.highlighted;
+    return out;
+}
+
+QDataStream& operator>>(QDataStream& in, ScrollbackLine& line) {
+    qint64 msecs = 0;
+    quint8 kind = 0;
+    in >> line.seq >> msecs >> line.buffer >> line.nick >> line.text >> kind >> line.highlighted;
+    line.timestamp = QDateTime::fromMSecsSinceEpoch(msecs);
+    line.kind = ScrollbackLine::Kind(kind);
+    return in;
+}
\ No newline at end of file
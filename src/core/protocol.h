@@ -0,0 +1,33 @@
+#pragma once
+#include <QByteArray>
+#include <QDataStream>
+#include <QString>
+#include "scrollback.h"
+
+class QIODevice;
+
+// Framing for the core <-> front-end link over a local socket. Every
+// frame is a 32-bit big-endian length, a type byte and a QDataStream
+// payload. After Hello the core answers with a Snapshot of the state and
+// a Lines frame holding only the scrollback the front-end has not seen.
+namespace CoreProtocol {
+
+const quint32 Version = 2;
+
+enum Type : quint8 {
+    Hello = 1,      // front-end: version, core instance, last seen seq
+    Command,        // front-end: kind, args
+    Snapshot,       // core: session and state
+    Lines,          // core: scrollback lines
+    Event           // core: kind, args
+};
+
+QString socketName();
+void writeFrame(QIODevice* device, Type type, const QByteArray& payload);
+// Pops one complete frame off the front of buffer, if there is one
+bool takeFrame(QByteArray& buffer, Type& type, QByteArray& payload);
+
+}
+
+QDataStream& operator<<(QDataStream& out, const ScrollbackLine& line);
+QDataStream& operator>>(QDataStream& in, ScrollbackLine& line);
\ No newline at end of file
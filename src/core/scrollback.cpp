@@ -0,0 +1,65 @@
+#include "scrollback.h"
+#include <algorithm>
+
+Scrollback::Scrollback(int capacity) : maxLines(capacity) {
+}
+
+quint64 Scrollback::append(ScrollbackLine line) {
+    line.seq = ++seq;
+    bufferFor(line.buffer).append(line);
+    return line.seq;
+}
+
+void Scrollback::insert(const ScrollbackLine& line) {
+    bufferFor(line.buffer).append(line);
+    seq = qMax(seq, line.seq);
+}
+
+void Scrollback::clear() {
+    buffersByKey.clear();
+    seq = 0;
+}
+
+QStringList Scrollback::buffers() const {
+    QStringList names;
+    for (const auto& cache : buffersByKey) {
+        if (!cache.isEmpty()) names << cache.last().buffer;
+    }
+    return names;
+}
+
+QVector<ScrollbackLine> Scrollback::lines(const QString& buffer, int limit) const {
+    QVector<ScrollbackLine> result;
+    auto it = buffersByKey.constFind(buffer.toLower());
+    if (it == buffersByKey.constEnd()) return result;
+
+    const auto& cache = *it;
+    int first = cache.firstIndex();
+    if (limit >= 0 && cache.count() > limit) first = cache.lastIndex() - limit + 1;
+    result.reserve(cache.lastIndex() - first + 1);
+    for (int i = first; i <= cache.lastIndex(); i++) result.append(cache.at(i));
+    return result;
+}
+
+QVector<ScrollbackLine> Scrollback::since(quint64 after) const {
+    QVector<ScrollbackLine> result;
+    for (const auto& cache : buffersByKey) {
+        // Sequence numbers grow within a buffer, so walk back from the end
+        int first = cache.lastIndex() + 1;
+        while (first > cache.firstIndex() && cache.at(first - 1).seq > after) first--;
+        for (int i = first; i <= cache.lastIndex(); i++) result.append(cache.at(i));
+    }
+    std::sort(result.begin(), result.end(), [](const ScrollbackLine& a, const ScrollbackLine& b) {
+        return a.seq < b.seq;
+    });
+    return result;
+}
+
+QContiguousCache<ScrollbackLine>& Scrollback::bufferFor(const QString& buffer) {
+    QString key = buffer.toLower();
+    auto it = buffersByKey.find(key);
+    if (it == buffersByKey.end()) {
+        it = buffersByKey.insert(key, QContiguousCache<ScrollbackLine>(maxLines));
+    }
+    return *it;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include <QContiguousCache>
+#include <QDateTime>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+struct ScrollbackLine {
+    enum Kind : quint8 { Message, Action, Notice, System };
+
+    quint64 seq = 0;
+    QDateTime timestamp;
+    QString buffer;     // channel or query nick, empty for the server
+    QString nick;
+    QString text;
+    Kind kind = System;
+    bool highlighted = false;
+};
+
+// Per-buffer ring buffers of display lines. Every line gets a global,
+// increasing sequence number so a front-end can ask for what it missed.
+// Only live lines are kept here, capacity per buffer; imported logs go to
+// the on-disk History instead.
+class Scrollback {
+public:
+    explicit Scrollback(int capacity = 10000);
+
+    quint64 append(ScrollbackLine line);
+    void insert(const ScrollbackLine& line);  // keeps the line's own seq
+    void clear();
+
+    QStringList buffers() const;
+    QVector<ScrollbackLine> lines(const QString& buffer, int limit = -1) const;
+    QVector<ScrollbackLine> since(quint64 seq) const;
+    quint64 lastSeq() const { return seq; }
+    int capacity() const { return maxLines; }
+
+private:
+    QHash<QString, QContiguousCache<ScrollbackLine>> buffersByKey;
+    quint64 seq = 0;
+    int maxLines;
+
+    QContiguousCache<ScrollbackLine>& bufferFor(const QString& buffer);
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <QObject>
+#include <QHostAddress>
+#include <QStringList>
+#include "history.h"
+#include "scrollback.h"
+#include "state.h"
+
+// What a front-end talks to: either an in-process IrcClient or a
+// CoreLink attached to a headless core holding the real connection.
+class Session : public QObject {
+    Q_OBJECT
+public:
+    explicit Session(QObject* parent = nullptr) : QObject(parent) {}
+
+    virtual void connectToServer(const QString& host, quint16 port = 6667) = 0;
+    virtual void disconnect() = 0;
+    virtual void sendRaw(const QString& line) = 0;
+    virtual void sendMessage(const QString& channel, const QString& message) = 0;
+    virtual void joinChannel(const QString& channel) = 0;
+    virtual void setNickname(const QString& nickname) = 0;
+    virtual void setUsername(const QString& username) = 0;
+    void sendCtcp(const QString& target, const QString& message) {
+        sendMessage(target, QString("\x01%1\x01").arg(message));
+    }
+
+    virtual QString nickname() const = 0;
+    virtual bool isConnected() const = 0;
+    virtual QHostAddress localAddress() const = 0;
+    virtual const IrcState* state() const = 0;
+    virtual const Scrollback* scrollback() const = 0;
+    virtual const History* history() const = 0;
+
+    virtual QStringList ignoreRules() const = 0;
+    virtual QStringList highlightRules() const = 0;
+    virtual void setIgnoreRules(const QStringList& rules) = 0;
+    virtual void setHighlightRules(const QStringList& rules) = 0;
+    virtual QString pluginReport() const = 0;
+
+    // Parses irssi/weechat/ZNC logs from files or directories into history
+    virtual void importLogs(const QStringList& paths) = 0;
+    virtual void cancelImport() = 0;
+
+signals:
+    void connected();
+    void disconnected();
+    void lineAdded(const ScrollbackLine& line);
+    void ctcpReceived(const QString& nickname, const QString& message);
+    void userJoined(const QString& channel, const QString& nickname);
+    void userLeft(const QString& channel, const QString& nickname);
+    void userQuit(const QString& nickname, const QStringList& channels, const QString& reason);
+    void nickChanged(const QString& oldNick, const QString& newNick, const QStringList& channels);
+    void channelModesChanged(const QString& channel, const QString& modes, const QStringList& args);
+    void namesReceived(const QString& channel);
+    void topicChanged(const QString& channel, const QString& topic);
+    void awayChanged(const QString& nickname, bool away);
+    void accountChanged(const QString& nickname, const QString& account);
+    void sessionRestored();
+    void historyChanged();
+    void importProgress(qint64 done, qint64 total);
+    void importFinished(qint64 lines, const QString& error);
+    void error(const QString& error);
+};
\ No newline at end of file
@@ -0,0 +1,395 @@
+#include "state.h"
+#include <QVector>
+#include <algorithm>
+
+namespace {
+
+template <class Key, class T>
+qint64 hashEntryBytes() {
+    // Node (next pointer, hash, key, value) plus its bucket slot
+    return 2 * sizeof(void*) + sizeof(uint) + sizeof(Key) + sizeof(T);
+}
+
+qint64 stringBytes(const QString& str) {
+    if (str.isNull()) return 0;
+    return sizeof(QArrayData) + (str.capacity() + 1) * sizeof(QChar);
+}
+
+}
+
+IrcState::IrcState() {
+}
+
+IrcState::~IrcState() {
+    clear();
+}
+
+void IrcState::clear() {
+    // The next server may announce different ISUPPORT values, or none
+    selfNick.clear();
+    isupportTokens.clear();
+    caseMapping = Rfc1459;
+    prefixModes = "ov";
+    prefixSymbols = "@+";
+    argModes = "beIk";
+    setArgModes = "l";
+    qDeleteAll(channels);
+    qDeleteAll(users);
+    channels.clear();
+    users.clear();
+}
+
+void IrcState::setSelf(const QString& nick) {
+    selfNick = nick;
+}
+
+bool IrcState::isSelf(const QString& nick) const {
+    return fold(nick) == fold(selfNick);
+}
+
+void IrcState::applyIsupport(const QStringList& tokens) {
+    isupportTokens += tokens;
+    for (const QString& token : tokens) {
+        QString key = token.section('=', 0, 0);
+        QString value = token.section('=', 1);
+
+        if (key == "CASEMAPPING") {
+            CaseMapping mapping = caseMapping;
+            if (value == "ascii") mapping = Ascii;
+            else if (value == "strict-rfc1459") mapping = StrictRfc1459;
+            else if (value == "rfc1459") mapping = Rfc1459;
+            if (mapping != caseMapping) {
+                caseMapping = mapping;
+                rebuildIndexes();
+            }
+        }
+        else if (key == "PREFIX") {
+            // PREFIX=(ov)@+
+            int close = value.indexOf(')');
+            if (value.startsWith('(') && close > 0) {
+                prefixModes = value.mid(1, close - 1);
+                prefixSymbols = value.mid(close + 1);
+            }
+        }
+        else if (key == "CHANMODES") {
+            // CHANMODES=A,B,C,D: list, always-arg, set-only-arg, no-arg
+            QStringList groups = value.split(',');
+            if (groups.size() >= 3) {
+                argModes = groups[0] + groups[1];
+                setArgModes = groups[2];
+            }
+        }
+    }
+}
+
+QString IrcState::fold(const QString& name) const {
+    QString folded = name;
+    for (QChar& c : folded) {
+        ushort u = c.unicode();
+        if (u >= 'A' && u <= 'Z') c = QChar(u + 32);
+        else if (caseMapping != Ascii && u >= '[' && u <= ']') c = QChar(u + 32);
+        else if (caseMapping == Rfc1459 && u == '~') c = QChar('^');
+    }
+    return folded;
+}
+
+void IrcState::join(const QString& channel, const QString& prefix) {
+    QString nick = prefix.section('!', 0, 0);
+    if (nick.isEmpty()) return;
+
+    IrcChannel* chan = internChannel(channel);
+    IrcUser* user = internUser(nick);
+    int bang = prefix.indexOf('!');
+    int at = prefix.indexOf('@');
+    if (bang > 0 && at > bang) {
+        user->user = prefix.mid(bang + 1, at - bang - 1);
+        user->host = prefix.mid(at + 1);
+    }
+
+    if (!chan->members.contains(user)) chan->members.insert(user, QString());
+    user->channels.insert(chan);
+}
+
+void IrcState::addNames(const QString& channel, const QStringList& entries) {
+    IrcChannel* chan = internChannel(channel);
+
+    for (const QString& entry : entries) {
+        int symbols = 0;
+        while (symbols < entry.size() && prefixSymbols.contains(entry.at(symbols))) symbols++;
+
+        // userhost-in-names replies carry the full nick!user@host
+        QString prefix = entry.mid(symbols);
+        join(channel, prefix);
+
+        IrcUser* user = users.value(fold(prefix.section('!', 0, 0)));
+        if (user && symbols > 0) {
+            QString modes = entry.left(symbols);
+            std::sort(modes.begin(), modes.end(), [this](QChar a, QChar b) {
+                return prefixSymbols.indexOf(a) < prefixSymbols.indexOf(b);
+            });
+            chan->members[user] = modes;
+        }
+    }
+}
+
+void IrcState::part(const QString& channel, const QString& nick) {
+    IrcChannel* chan = findChannel(channel);
+    if (!chan) return;
+
+    if (isSelf(nick)) {
+        // We left: the whole channel goes, and with it anyone only seen there
+        channels.remove(fold(chan->name));
+        const auto members = chan->members.keys();
+        for (IrcUser* user : members) {
+            user->channels.remove(chan);
+            releaseUser(user);
+        }
+        delete chan;
+        return;
+    }
+
+    IrcUser* user = users.value(fold(nick));
+    if (user) removeMember(chan, user);
+}
+
+QStringList IrcState::quit(const QString& nick) {
+    QStringList names;
+    IrcUser* user = users.value(fold(nick));
+    if (!user) return names;
+
+    for (IrcChannel* chan : qAsConst(user->channels)) {
+        chan->members.remove(user);
+        names << chan->name;
+    }
+    user->channels.clear();
+    users.remove(fold(nick));
+    delete user;
+    return names;
+}
+
+QStringList IrcState::rename(const QString& oldNick, const QString& newNick) {
+    QStringList names;
+    if (isSelf(oldNick)) selfNick = newNick;
+
+    IrcUser* user = users.value(fold(oldNick));
+    if (!user) return names;
+
+    QString newKey = fold(newNick);
+    IrcUser* stale = users.value(newKey);
+    if (stale && stale != user) quit(stale->nick);
+
+    users.remove(fold(oldNick));
+    user->nick = newNick;
+    users.insert(newKey, user);
+
+    for (IrcChannel* chan : qAsConst(user->channels)) names << chan->name;
+    return names;
+}
+
+QStringList IrcState::applyMode(const QString& channel, const QString& modes, const QStringList& args) {
+    QStringList affected;
+    IrcChannel* chan = findChannel(channel);
+    if (!chan) return affected;
+
+    bool adding = true;
+    int arg = 0;
+    for (QChar mode : modes) {
+        if (mode == '+' || mode == '-') {
+            adding = mode == '+';
+            continue;
+        }
+
+        bool takesArg = argModes.contains(mode) || prefixModes.contains(mode)
+                     || (adding && setArgModes.contains(mode));
+        if (!takesArg) continue;
+        if (arg >= args.size()) break;
+        QString target = args.at(arg++);
+
+        int rank = prefixModes.indexOf(mode);
+        if (rank < 0 || rank >= prefixSymbols.size()) continue;
+
+        IrcUser* user = users.value(fold(target));
+        if (!user || !chan->members.contains(user)) continue;
+
+        QString& symbols = chan->members[user];
+        QChar symbol = prefixSymbols.at(rank);
+        symbols.remove(symbol);
+        if (adding) {
+            int pos = 0;
+            while (pos < symbols.size() && prefixSymbols.indexOf(symbols.at(pos)) < rank) pos++;
+            symbols.insert(pos, symbol);
+        }
+        affected << user->nick;
+    }
+    return affected;
+}
+
+void IrcState::setTopic(const QString& channel, const QString& topic) {
+    if (IrcChannel* chan = findChannel(channel)) chan->topic = topic;
+}
+
+void IrcState::setAway(const QString& nick, bool away) {
+    if (IrcUser* user = users.value(fold(nick))) user->away = away;
+}
+
+void IrcState::setAccount(const QString& nick, const QString& account) {
+    if (IrcUser* user = users.value(fold(nick))) user->account = account == "*" ? QString() : account;
+}
+
+const IrcChannel* IrcState::channel(const QString& name) const {
+    return findChannel(name);
+}
+
+const IrcUser* IrcState::user(const QString& nick) const {
+    return users.value(fold(nick));
+}
+
+QStringList IrcState::channelNames() const {
+    QStringList names;
+    for (const IrcChannel* chan : channels) names << chan->name;
+    return names;
+}
+
+QStringList IrcState::channelNicks(const QString& channel) const {
+    QStringList nicks;
+    if (const IrcChannel* chan = findChannel(channel)) {
+        nicks.reserve(chan->members.size());
+        for (auto it = chan->members.cbegin(); it != chan->members.cend(); ++it) nicks << it.key()->nick;
+    }
+    return nicks;
+}
+
+QStringList IrcState::channelUsers(const QString& channel) const {
+    QStringList result;
+    const IrcChannel* chan = findChannel(channel);
+    if (!chan) return result;
+
+    struct Row { int rank; QString key; QString display; };
+    QVector<Row> rows;
+    rows.reserve(chan->members.size());
+    for (auto it = chan->members.cbegin(); it != chan->members.cend(); ++it) {
+        const QString& symbols = it.value();
+        int rank = symbols.isEmpty() ? prefixSymbols.size() : prefixSymbols.indexOf(symbols.at(0));
+        QString display = symbols.isEmpty() ? it.key()->nick : symbols.at(0) + it.key()->nick;
+        rows.append({rank, fold(it.key()->nick), display});
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        return a.rank != b.rank ? a.rank < b.rank : a.key < b.key;
+    });
+
+    result.reserve(rows.size());
+    for (const Row& row : rows) result << row.display;
+    return result;
+}
+
+int IrcState::membershipCount() const {
+    int count = 0;
+    for (const IrcChannel* chan : channels) count += chan->members.size();
+    return count;
+}
+
+qint64 IrcState::approximateMemory() const {
+    qint64 bytes = 0;
+    for (auto it = users.cbegin(); it != users.cend(); ++it) {
+        const IrcUser* user = it.value();
+        bytes += sizeof(IrcUser) + hashEntryBytes<QString, IrcUser*>() + stringBytes(it.key());
+        bytes += stringBytes(user->nick) + stringBytes(user->user)
+               + stringBytes(user->host) + stringBytes(user->account);
+        bytes += user->channels.size() * hashEntryBytes<IrcChannel*, QHashDummyValue>();
+    }
+    for (auto it = channels.cbegin(); it != channels.cend(); ++it) {
+        const IrcChannel* chan = it.value();
+        bytes += sizeof(IrcChannel) + hashEntryBytes<QString, IrcChannel*>() + stringBytes(it.key());
+        bytes += stringBytes(chan->name) + stringBytes(chan->topic);
+        bytes += chan->members.size() * hashEntryBytes<IrcUser*, QString>();
+        for (const QString& symbols : chan->members) bytes += stringBytes(symbols);
+    }
+    return bytes;
+}
+
+QString IrcState::memoryReport() const {
+    int memberships = membershipCount();
+    qint64 bytes = approximateMemory();
+    double per100k = memberships ? bytes * 100000.0 / memberships / (1024 * 1024) : 0.0;
+    return QString("%1 users, %2 channels, %3 memberships, ~%4 KiB (%5 MiB per 100k memberships)")
+        .arg(users.size())
+        .arg(channels.size())
+        .arg(memberships)
+        .arg(bytes / 1024)
+        .arg(per100k, 0, 'f', 2);
+}
+
+IrcUser* IrcState::internUser(const QString& nick) {
+    QString key = fold(nick);
+    IrcUser* user = users.value(key);
+    if (!user) {
+        user = new IrcUser;
+        user->nick = nick;
+        users.insert(key, user);
+    }
+    return user;
+}
+
+IrcChannel* IrcState::internChannel(const QString& name) {
+    QString key = fold(name);
+    IrcChannel* chan = channels.value(key);
+    if (!chan) {
+        chan = new IrcChannel;
+        chan->name = name;
+        channels.insert(key, chan);
+    }
+    return chan;
+}
+
+IrcChannel* IrcState::findChannel(const QString& name) const {
+    return channels.value(fold(name));
+}
+
+void IrcState::removeMember(IrcChannel* chan, IrcUser* user) {
+    chan->members.remove(user);
+    user->channels.remove(chan);
+    releaseUser(user);
+}
+
+void IrcState::releaseUser(IrcUser* user) {
+    if (!user->channels.isEmpty() || isSelf(user->nick)) return;
+    users.remove(fold(user->nick));
+    delete user;
+}
+
+void IrcState::rebuildIndexes() {
+    // Under the new mapping two entries can fold to the same key; merge
+    // the later one into the first instead of losing track of it
+    QHash<QString, IrcUser*> rebuiltUsers;
+    for (IrcUser* user : qAsConst(users)) {
+        IrcUser* kept = rebuiltUsers.value(fold(user->nick));
+        if (!kept) {
+            rebuiltUsers.insert(fold(user->nick), user);
+            continue;
+        }
+        for (IrcChannel* chan : qAsConst(user->channels)) {
+            QString modes = chan->members.take(user);
+            if (!chan->members.contains(kept)) chan->members.insert(kept, modes);
+            kept->channels.insert(chan);
+        }
+        delete user;
+    }
+    users.swap(rebuiltUsers);
+
+    QHash<QString, IrcChannel*> rebuiltChannels;
+    for (IrcChannel* chan : qAsConst(channels)) {
+        IrcChannel* kept = rebuiltChannels.value(fold(chan->name));
+        if (!kept) {
+            rebuiltChannels.insert(fold(chan->name), chan);
+            continue;
+        }
+        for (auto it = chan->members.cbegin(); it != chan->members.cend(); ++it) {
+            if (!kept->members.contains(it.key())) kept->members.insert(it.key(), it.value());
+            it.key()->channels.remove(chan);
+            it.key()->channels.insert(kept);
+        }
+        if (kept->topic.isEmpty()) kept->topic = chan->topic;
+        delete chan;
+    }
+    channels.swap(rebuiltChannels);
+}
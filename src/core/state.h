@@ -0,0 +1,85 @@
+#pragma once
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+struct IrcChannel;
+
+// Users are interned once per connection and shared by every channel
+// they are in, so NICK/QUIT touch only that user's own channels.
+struct IrcUser {
+    QString nick;
+    QString user;
+    QString host;
+    QString account;
+    bool away = false;
+    QSet<IrcChannel*> channels;
+};
+
+struct IrcChannel {
+    QString name;
+    QString topic;
+    QHash<IrcUser*, QString> members;  // user -> prefix modes, e.g. "@+"
+};
+
+class IrcState {
+public:
+    enum CaseMapping { Ascii, Rfc1459, StrictRfc1459 };
+
+    IrcState();
+    ~IrcState();
+    IrcState(const IrcState&) = delete;
+    IrcState& operator=(const IrcState&) = delete;
+
+    void clear();
+    void setSelf(const QString& nick);
+    QString self() const { return selfNick; }
+    bool isSelf(const QString& nick) const;
+
+    // RPL_ISUPPORT tokens: CASEMAPPING, PREFIX and CHANMODES are used
+    void applyIsupport(const QStringList& tokens);
+    QStringList isupport() const { return isupportTokens; }
+    QString fold(const QString& name) const;
+
+    void join(const QString& channel, const QString& prefix);
+    void addNames(const QString& channel, const QStringList& entries);
+    void part(const QString& channel, const QString& nick);
+    QStringList quit(const QString& nick);
+    QStringList rename(const QString& oldNick, const QString& newNick);
+    QStringList applyMode(const QString& channel, const QString& modes, const QStringList& args);
+    void setTopic(const QString& channel, const QString& topic);
+    void setAway(const QString& nick, bool away);
+    void setAccount(const QString& nick, const QString& account);
+
+    const IrcChannel* channel(const QString& name) const;
+    const IrcUser* user(const QString& nick) const;
+    QStringList channelNames() const;
+    QStringList channelNicks(const QString& channel) const;
+    // Members with their highest prefix, ops first then alphabetical
+    QStringList channelUsers(const QString& channel) const;
+
+    int userCount() const { return users.size(); }
+    int channelCount() const { return channels.size(); }
+    int membershipCount() const;
+    qint64 approximateMemory() const;
+    QString memoryReport() const;
+
+private:
+    QHash<QString, IrcUser*> users;
+    QHash<QString, IrcChannel*> channels;
+    QString selfNick;
+    QStringList isupportTokens;
+
+    CaseMapping caseMapping = Rfc1459;
+    QString prefixModes = "ov";
+    QString prefixSymbols = "@+";
+    QString argModes = "beIk";      // always take an argument
+    QString setArgModes = "l";      // take an argument only when set
+
+    IrcUser* internUser(const QString& nick);
+    IrcChannel* internChannel(const QString& name);
+    IrcChannel* findChannel(const QString& name) const;
+    void removeMember(IrcChannel* chan, IrcUser* user);
+    void releaseUser(IrcUser* user);
+    void rebuildIndexes();
+};
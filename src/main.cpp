@@ -1,13 +1,144 @@
 #include <QApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFontDatabase>
+#include <QScrollBar>
+#include <QSettings>
 #include "ui/main_win.h"
+#include "ui/widgets/mono_view.h"
+#include "core/client.h"
+#include "core/core_link.h"
+#include "core/core_server.h"
+
+namespace {
+
+IrcClient* createClient(QObject* parent) {
+    auto client = new IrcClient(parent);
+    QSettings settings("ComSock", "ComSock");
+    client->setIgnoreRules(settings.value("filter/ignore").toStringList());
+    client->setHighlightRules(settings.value("filter/highlight").toStringList());
+    client->plugins()->loadPlugins();
+    return client;
+}
+
+// Imports into a running core's history, or into the local one when there is none
+int importLogs(QCoreApplication& app, const QStringList& paths) {
+    CoreLink link;
+    IrcClient local;
+    Session* session = &link;
+    if (!link.attach()) {
+        qInfo() << "No core is running; importing into the local history";
+        session = &local;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 bytes = 0;
+    int shown = -1;
+    int status = 0;
+    QObject::connect(session, &Session::importProgress, [&](qint64 done, qint64 total) {
+        bytes = total;
+        int percent = total > 0 ? int(done * 100 / total) : 100;
+        if (percent / 10 != shown / 10) qInfo().noquote() << QString("%1%").arg(percent);
+        shown = percent;
+    });
+    QObject::connect(session, &Session::importFinished, [&](qint64 lines, const QString& error) {
+        qint64 ms = qMax<qint64>(1, timer.elapsed());
+        qInfo().noquote() << QString("Imported %1 lines from %2 MiB in %3 ms (%4 MiB/s)")
+            .arg(lines).arg(bytes / (1024 * 1024)).arg(ms)
+            .arg(bytes * 1000.0 / ms / (1024 * 1024), 0, 'f', 1);
+        if (!error.isEmpty()) {
+            qWarning().noquote() << error;
+            status = 1;
+        }
+        QMetaObject::invokeMethod(&app, "quit", Qt::QueuedConnection);
+    });
+
+    session->importLogs(paths);
+    app.exec();
+    return status;
+}
+
+// Fills each display mode with count lines, then pages through all of it
+int benchDisplay(int count) {
+    for (ChatDisplay::Mode mode : {ChatDisplay::Monospace, ChatDisplay::RichText}) {
+        ChatDisplay display(mode);
+        if (auto mono = qobject_cast<MonoView*>(display.view())) mono->setCapacity(count);
+        display.resize(800, 600);
+        display.show();
+
+        QElapsedTimer timer;
+        timer.start();
+        QDateTime now = QDateTime::currentDateTime();
+        for (int i = 0; i < count; i++) {
+            display.addMessage(QString("nick%1").arg(i % 40),
+                               QString("line %1 ").arg(i) + QString("lorem ipsum ").repeated(1 + i % 24), now);
+        }
+        qint64 fillMs = timer.restart();
+
+        QScrollBar* bar = display.view()->verticalScrollBar();
+        int frames = 0;
+        for (int value = 0; value <= bar->maximum(); value += bar->pageStep()) {
+            bar->setValue(value);
+            display.view()->viewport()->repaint();
+            frames++;
+        }
+        qint64 scrollMs = qMax<qint64>(1, timer.elapsed());
+
+        qInfo().noquote() << QString("%1: %2 lines appended in %3 ms, %4 pages scrolled in %5 ms (%6 pages/s)")
+            .arg(mode == ChatDisplay::Monospace ? "monospace" : "rich text")
+            .arg(count).arg(fillMs).arg(frames).arg(scrollMs)
+            .arg(frames * 1000.0 / scrollMs, 0, 'f', 1);
+    }
+    return 0;
+}
+
+}
 
 int main(int argc, char *argv[]) {
+    // Headless core: holds the IRC connection and serves it to front-ends
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--core") == 0) {
+            QCoreApplication app(argc, argv);
+            IrcClient* client = createClient(&app);
+            CoreServer server(client);
+            if (!server.listen()) return 1;
+            return app.exec();
+        }
+        if (qstrcmp(argv[i], "--import") == 0) {
+            QCoreApplication app(argc, argv);
+            QStringList paths = app.arguments().mid(i + 1);
+            if (paths.isEmpty()) {
+                qWarning() << "Usage: ComSock --import <log file or directory>...";
+                return 1;
+            }
+            return importLogs(app, paths);
+        }
+    }
+
     QApplication app(argc, argv);
+    QFontDatabase::addApplicationFont(":/fonts/TerminusTTF-4.49.3.ttf");
+    QFontDatabase::addApplicationFont(":/fonts/TerminusTTF-Bold-4.49.3.ttf");
+
+    int bench = app.arguments().indexOf("--bench-display");
+    if (bench > 0) {
+        int count = app.arguments().value(bench + 1).toInt();
+        return benchDisplay(count > 0 ? count : 100000);
+    }
+
+    // Attach to a running core if there is one, otherwise run in-process
+    Session* session = nullptr;
+    if (!app.arguments().contains("--standalone")) {
+        auto link = new CoreLink(&app);
+        if (link->attach()) session = link;
+        else delete link;
+    }
+    if (!session) session = createClient(&app);
     
-    MainWindow window;
+    MainWindow window(session);
     window.setWindowTitle("ComSock");
     window.resize(800, 600);
     window.show();
     
     return app.exec();
-} 
\ No newline at end of file
+}
\ No newline at end of file
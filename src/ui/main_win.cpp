@@ -4,34 +4,64 @@
 #include <QHBoxLayout>
 #include <QSplitter>
 #include <QMessageBox>
+#include <QInputDialog>
+#include <QProgressDialog>
+#include <QFileDialog>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFileInfo>
+#include <QPushButton>
+#include <QSettings>
 #include <QApplication>
 #include <QDebug>
 
-MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
+MainWindow::MainWindow(Session* session, QWidget* parent) : QMainWindow(parent), session(session) {
     setWindowTitle("ComSock");
     resize(800, 600);
 
     // Initialize all pointers first
-    ircClient = new IrcClient(this);
     channelList = new ChannelList(this);
     userList = new UserList(this);
+    userList->setState(session->state());
     channelTabs = new QTabWidget(this);
-    messageInput = new QLineEdit(this);
+    messageInput = new InputLine(this);
+    nickIndex.setState(session->state());
+    messageInput->setNickIndex(&nickIndex);
     nickDisplay = new QLabel(this);
+    dccManager = new DccManager(session, this);
+    transferList = new TransferList(dccManager, this);
+    transferDock = new QDockWidget(tr("Transfers"), this);
     
     // Setup UI
+    bool mono = QSettings("ComSock", "ComSock").value("display/monospace").toBool();
+    ChatDisplay::setDefaultMode(mono ? ChatDisplay::Monospace : ChatDisplay::RichText);
     setupMenuBar();
     setupLayout();
+    loadFilterRules();
     
     // Connect signals
-    connect(ircClient, &IrcClient::messageReceived, this, &MainWindow::handleMessageReceived);
-    connect(ircClient, &IrcClient::userJoined, this, &MainWindow::handleUserJoined);
-    connect(ircClient, &IrcClient::userLeft, this, &MainWindow::handleUserLeft);
+    connect(session, &Session::lineAdded, this, &MainWindow::handleLineAdded);
+    connect(session, &Session::userJoined, this, &MainWindow::handleUserJoined);
+    connect(session, &Session::userLeft, this, &MainWindow::handleUserLeft);
+    connect(session, &Session::userQuit, this, &MainWindow::handleUserQuit);
+    connect(session, &Session::nickChanged, this, &MainWindow::handleNickChanged);
+    connect(session, &Session::channelModesChanged, userList, &UserList::refreshChannel);
+    connect(session, &Session::namesReceived, this, &MainWindow::handleNamesReceived);
+    connect(session, &Session::sessionRestored, this, &MainWindow::restoreSession);
+    connect(session, &Session::historyChanged, this, &MainWindow::rebuildTabs);
+    connect(session, &Session::disconnected, this, [this]() { nickIndex.clear(); });
     connect(messageInput, &QLineEdit::returnPressed, this, &MainWindow::sendMessage);
     connect(channelTabs, &QTabWidget::currentChanged, this, &MainWindow::handleTabChanged);
+    connect(channelList, &ChannelList::channelChanged, this, &MainWindow::handleChannelChanged);
+    connect(dccManager, &DccManager::transferAdded, transferDock, &QDockWidget::show);
+    connect(transferList, &TransferList::acceptRequested, this, &MainWindow::acceptTransfer);
     
-    // Show connect dialog on startup
-    QTimer::singleShot(0, this, &MainWindow::showConnectDialog);
+    // A core may already be connected and in channels
+    restoreSession();
+    listHistory();
+    if (!session->isConnected()) {
+        QTimer::singleShot(0, this, &MainWindow::showConnectDialog);
+    }
 }
 
 void MainWindow::setupMenuBar() {
@@ -42,8 +72,29 @@ void MainWindow::setupMenuBar() {
     fileMenu->addAction(tr("&Connect"), this, &MainWindow::showConnectDialog);
     fileMenu->addAction(tr("&Disconnect"), this, &MainWindow::handleDisconnect);
     fileMenu->addSeparator();
+    fileMenu->addAction(tr("Send &File..."), this, [this]() { sendFile(false); });
+    fileMenu->addAction(tr("Send File (&Passive)..."), this, [this]() { sendFile(true); });
+    fileMenu->addAction(tr("&Transfers"), transferDock, &QDockWidget::show);
+    fileMenu->addSeparator();
+    fileMenu->addAction(tr("&Import Logs..."), this, &MainWindow::importLogs);
+    fileMenu->addSeparator();
     fileMenu->addAction(tr("E&xit"), qApp, &QApplication::quit);
     
+    auto toolsMenu = menuBar->addMenu(tr("&Tools"));
+    toolsMenu->addAction(tr("&Ignore List..."), this, &MainWindow::editIgnoreList);
+    toolsMenu->addAction(tr("&Highlights..."), this, &MainWindow::editHighlights);
+    auto monoAction = toolsMenu->addAction(tr("&Monospace Display"));
+    monoAction->setCheckable(true);
+    monoAction->setChecked(ChatDisplay::defaultMode() == ChatDisplay::Monospace);
+    connect(monoAction, &QAction::toggled, this, &MainWindow::setMonospace);
+    toolsMenu->addSeparator();
+    toolsMenu->addAction(tr("&Plugins"), this, [this]() {
+        QMessageBox::information(this, tr("Plugins"), session->pluginReport());
+    });
+    toolsMenu->addAction(tr("&State Statistics"), this, [this]() {
+        QMessageBox::information(this, tr("State Statistics"), session->state()->memoryReport());
+    });
+    
     auto helpMenu = menuBar->addMenu(tr("&Help"));
     helpMenu->addAction(tr("&About"), this, &MainWindow::about);
 }
@@ -83,13 +134,18 @@ void MainWindow::setupLayout() {
     
     mainLayout->addLayout(topLayout);
     mainLayout->addWidget(splitter);
+    
+    // Bottom - DCC transfers, shown once there is something to show
+    transferDock->setWidget(transferList);
+    addDockWidget(Qt::BottomDockWidgetArea, transferDock);
+    transferDock->hide();
 }
 
 void MainWindow::showConnectDialog() {
     auto dialog = new ConnectDialog(this);
     if (dialog->exec() == QDialog::Accepted) {
         // Disconnect old signal connections if any
-        disconnect(ircClient, &IrcClient::connected, nullptr, nullptr);
+        disconnect(session, &Session::connected, nullptr, nullptr);
         
         QString nickname = dialog->getNickname();
         QString username = dialog->getUsername();
@@ -106,16 +162,16 @@ void MainWindow::showConnectDialog() {
         createChannelTab("#test");
         
         // Set up client before connecting
-        ircClient->setNickname(nickname);
-        ircClient->setUsername(username);
+        session->setNickname(nickname);
+        session->setUsername(username);
         
         // Connect signals
-        connect(ircClient, &IrcClient::connected, this, [this]() {
+        connect(session, &Session::connected, this, [this]() {
             qDebug() << "Successfully registered with server, joining channel...";
-            ircClient->joinChannel("#test");
+            session->joinChannel("#test");
         });
         
-        connect(ircClient, &IrcClient::error, this, [this](const QString& error) {
+        connect(session, &Session::error, this, [this](const QString& error) {
             QMessageBox::critical(this, "Connection Error", 
                                 "Failed to connect: " + error);
         });
@@ -125,34 +181,27 @@ void MainWindow::showConnectDialog() {
         
         // Connect to server
         qDebug() << "Connecting to server:" << server;
-        ircClient->connectToServer(server);
+        session->connectToServer(server);
     }
     dialog->deleteLater();
 }
 
-void MainWindow::handleMessageReceived(const IrcMessage& message) {
-    // Create channel tab if it doesn't exist
-    if (!channelDisplays.contains("#test")) {
-        createChannelTab("#test");
-    }
-    
-    // Display all messages in the default channel for now
-    auto display = channelDisplays["#test"];
-    if (!display) return;
-    
-    if (message.command == "PRIVMSG") {
-        display->addMessage(message.nickname(), message.trailing);
-    }
-    else if (message.command == "NOTICE") {
-        display->addSystemMessage(QString("NOTICE: %1").arg(message.trailing));
-    }
-    else if (message.command == "ERROR") {
-        display->addSystemMessage(QString("ERROR: %1").arg(message.trailing));
+void MainWindow::handleLineAdded(const ScrollbackLine& line) {
+    const IrcState* state = session->state();
+    bool inChannel = state->channel(line.buffer);
+    // Our own lines must not put our nick first in completion
+    if (inChannel && !state->isSelf(line.nick) &&
+        (line.kind == ScrollbackLine::Message || line.kind == ScrollbackLine::Action)) {
+        nickIndex.touch(line.buffer, line.nick);
     }
-    else if (message.command.toInt() > 0) {
-        // Numeric replies
-        display->addSystemMessage(message.trailing);
+
+    // A new channel tab starts with its history, which already holds this line
+    if (!findDisplay(line.buffer) && inChannel) {
+        createChannelTab(line.buffer);
+        replayHistory(channelDisplays[line.buffer], line.buffer);
+        return;
     }
+    if (auto display = displayFor(line.buffer)) showLine(display, line);
 }
 
 void MainWindow::sendMessage() {
@@ -160,17 +209,150 @@ void MainWindow::sendMessage() {
         return;
     }
     
-    QString message = messageInput->text();
-    ircClient->sendMessage(currentChannel, message);
-    
-    // Show message in our own chat display
-    if (auto display = channelDisplays[currentChannel]) {
-        display->addMessage(ircClient->nickname(), message);
-    }
-    
+    // Our own line comes back through the scrollback like any other
+    session->sendMessage(currentChannel, messageInput->text());
     messageInput->clear();
 }
 
+void MainWindow::sendFile(bool passive) {
+    bool ok = false;
+    QString nick = QInputDialog::getText(this, tr("Send File"), tr("Send to nickname:"),
+                                         QLineEdit::Normal, QString(), &ok);
+    if (!ok || nick.trimmed().isEmpty()) return;
+
+    QString path = QFileDialog::getOpenFileName(this, tr("Send File"));
+    if (path.isEmpty()) return;
+
+    dccManager->sendFile(nick.trimmed(), path, passive);
+}
+
+void MainWindow::acceptTransfer(int id) {
+    auto transfer = dccManager->transfer(id);
+    if (!transfer) return;
+
+    QString downloads = QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
+    QString path = QFileDialog::getSaveFileName(this, tr("Save File"),
+        QDir(downloads).filePath(transfer->fileName), QString(), nullptr,
+        QFileDialog::DontConfirmOverwrite);
+    if (path.isEmpty()) return;
+
+    // Never truncate an existing file without asking; a shorter one can be resumed
+    bool resume = false;
+    QFileInfo existing(path);
+    if (existing.isFile() && existing.size() > 0) {
+        QMessageBox box(QMessageBox::Question, tr("File Exists"),
+            tr("%1 already exists (%2 of %3 bytes).")
+                .arg(existing.fileName()).arg(existing.size()).arg(transfer->size),
+            QMessageBox::NoButton, this);
+        QPushButton* resumeButton = nullptr;
+        if (existing.size() < transfer->size) resumeButton = box.addButton(tr("Resume"), QMessageBox::AcceptRole);
+        QPushButton* overwriteButton = box.addButton(tr("Overwrite"), QMessageBox::DestructiveRole);
+        QPushButton* renameButton = box.addButton(tr("Rename"), QMessageBox::ActionRole);
+        box.addButton(tr("Skip"), QMessageBox::RejectRole);
+        box.setDefaultButton(resumeButton ? resumeButton : renameButton);
+        box.exec();
+
+        if (box.clickedButton() == resumeButton) {
+            resume = true;
+        } else if (box.clickedButton() == renameButton) {
+            QDir dir = existing.dir();
+            QString base = existing.completeBaseName();
+            QString suffix = existing.suffix().isEmpty() ? QString() : '.' + existing.suffix();
+            for (int n = 1; QFileInfo::exists(path); ++n) {
+                path = dir.filePath(QString("%1 (%2)%3").arg(base).arg(n).arg(suffix));
+            }
+        } else if (box.clickedButton() != overwriteButton) {
+            return;
+        }
+    }
+    dccManager->accept(id, path, resume);
+}
+
+void MainWindow::loadFilterRules() {
+    QSettings settings("ComSock", "ComSock");
+    session->setIgnoreRules(settings.value("filter/ignore").toStringList());
+    session->setHighlightRules(settings.value("filter/highlight").toStringList());
+}
+
+void MainWindow::editIgnoreList() {
+    bool ok = false;
+    QString rules = QInputDialog::getMultiLineText(this, tr("Ignore List"),
+        tr("One rule per line: nick!user@host masks, keywords or /regex/"),
+        session->ignoreRules().join('\n'), &ok);
+    if (!ok) return;
+
+    QStringList list = rules.split('\n', Qt::SkipEmptyParts);
+    session->setIgnoreRules(list);
+    QSettings("ComSock", "ComSock").setValue("filter/ignore", session->ignoreRules());
+}
+
+void MainWindow::editHighlights() {
+    bool ok = false;
+    QString rules = QInputDialog::getMultiLineText(this, tr("Highlights"),
+        tr("One rule per line: nick!user@host masks, keywords or /regex/"),
+        session->highlightRules().join('\n'), &ok);
+    if (!ok) return;
+
+    QStringList list = rules.split('\n', Qt::SkipEmptyParts);
+    session->setHighlightRules(list);
+    QSettings("ComSock", "ComSock").setValue("filter/highlight", session->highlightRules());
+}
+
+void MainWindow::setMonospace(bool enabled) {
+    ChatDisplay::setDefaultMode(enabled ? ChatDisplay::Monospace : ChatDisplay::RichText);
+    QSettings("ComSock", "ComSock").setValue("display/monospace", enabled);
+
+    rebuildTabs();
+}
+
+void MainWindow::importLogs() {
+    QString path = QFileDialog::getExistingDirectory(this, tr("Import Logs"), QDir::homePath());
+    if (path.isEmpty()) return;
+
+    auto progress = new QProgressDialog(tr("Importing logs..."), tr("Cancel"), 0, 1000, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(0);
+    connect(progress, &QProgressDialog::canceled, session, &Session::cancelImport);
+    connect(session, &Session::importProgress, progress, [progress](qint64 done, qint64 total) {
+        progress->setValue(total > 0 ? int(done * 1000 / total) : 0);
+    });
+    connect(session, &Session::importFinished, progress, [this, progress](qint64 lines, const QString& error) {
+        progress->deleteLater();
+        if (error.isEmpty()) {
+            QMessageBox::information(this, tr("Import Logs"), tr("Imported %1 lines.").arg(lines));
+        } else {
+            QMessageBox::warning(this, tr("Import Logs"),
+                                 tr("Imported %1 lines.\n\n%2").arg(lines).arg(error));
+        }
+    });
+    session->importLogs({path});
+}
+
+void MainWindow::rebuildTabs() {
+    int current = channelTabs->currentIndex();
+    for (int i = 0; i < channelTabs->count(); i++) {
+        QString channel = channelTabs->tabText(i);
+        auto display = new ChatDisplay(this);
+        replayHistory(display, channel);
+
+        QWidget* old = channelTabs->widget(i);
+        channelTabs->removeTab(i);
+        channelTabs->insertTab(i, display, channel);
+        channelDisplays[channel] = display;
+        old->deleteLater();
+    }
+    channelTabs->setCurrentIndex(current);
+    listHistory();
+}
+
+void MainWindow::listHistory() {
+    // Imported buffers are listed without a tab until they are opened
+    const QStringList buffers = session->history()->buffers();
+    for (const QString& buffer : buffers) {
+        if (!buffer.isEmpty()) channelList->addChannel(buffer);
+    }
+}
+
 void MainWindow::createChannelTab(const QString& channel) {
     if (!channelDisplays.contains(channel)) {
         auto display = new ChatDisplay(this);
@@ -181,9 +363,81 @@ void MainWindow::createChannelTab(const QString& channel) {
     }
 }
 
+ChatDisplay* MainWindow::findDisplay(const QString& buffer) const {
+    for (auto it = channelDisplays.cbegin(); it != channelDisplays.cend(); ++it) {
+        if (it.key().compare(buffer, Qt::CaseInsensitive) == 0) return it.value();
+    }
+    return nullptr;
+}
+
+ChatDisplay* MainWindow::displayFor(const QString& buffer) {
+    if (auto display = findDisplay(buffer)) return display;
+
+    // Server and query lines go wherever the user is looking
+    if (auto display = channelDisplays.value(currentChannel)) return display;
+    if (!channelDisplays.contains("#test")) createChannelTab("#test");
+    return channelDisplays.value("#test");
+}
+
+void MainWindow::showLine(ChatDisplay* display, const ScrollbackLine& line) {
+    switch (line.kind) {
+    case ScrollbackLine::Message:
+        if (line.highlighted) display->addHighlightedMessage(line.nick, line.text, line.timestamp);
+        else display->addMessage(line.nick, line.text, line.timestamp);
+        break;
+    case ScrollbackLine::Action:
+        display->addUserAction(line.nick, line.text, line.timestamp);
+        break;
+    case ScrollbackLine::Notice:
+        display->addSystemMessage(QString("NOTICE: %1").arg(line.text), line.timestamp);
+        break;
+    case ScrollbackLine::System:
+        display->addSystemMessage(line.text, line.timestamp);
+        break;
+    }
+}
+
+void MainWindow::replayHistory(ChatDisplay* display, const QString& buffer) {
+    const int limit = 1000;
+    const auto live = session->scrollback()->lines(buffer, limit);
+
+    // Imported lines come first, as long as they predate what is live
+    if (live.size() < limit) {
+        const auto imported = session->history()->lines(buffer, limit - live.size());
+        for (const ScrollbackLine& line : imported) {
+            if (live.isEmpty() || line.timestamp < live.first().timestamp) showLine(display, line);
+        }
+    }
+    for (const ScrollbackLine& line : live) showLine(display, line);
+}
+
+void MainWindow::restoreSession() {
+    const IrcState* state = session->state();
+    if (session->isConnected()) nickDisplay->setText(session->nickname());
+
+    // Replay history only into tabs that did not exist yet
+    const QStringList channels = state->channelNames();
+    nickIndex.setChannels(channels);
+    for (const QString& channel : channels) {
+        bool fresh = !channelDisplays.contains(channel);
+        createChannelTab(channel);
+        if (fresh) replayHistory(channelDisplays[channel], channel);
+        nickIndex.setUsers(channel, state->channelNicks(channel));
+        userList->refreshChannel(channel);
+    }
+}
+
 void MainWindow::handleChannelChanged(const QString& channel) {
+    if (!findDisplay(channel) && session->history()->contains(channel)) {
+        auto display = new ChatDisplay(this);
+        channelDisplays[channel] = display;
+        channelTabs->addTab(display, channel);
+        replayHistory(display, channel);
+    }
+
     currentChannel = channel;
     userList->setCurrentChannel(channel);
+    messageInput->setChannel(channel);
     
     // Find and activate the corresponding tab
     for (int i = 0; i < channelTabs->count(); i++) {
@@ -206,28 +460,52 @@ void MainWindow::handleConnect() {
 }
 
 void MainWindow::handleDisconnect() {
-    ircClient->disconnect();
+    session->disconnect();
     for (auto display : channelDisplays) {
         display->addSystemMessage("Disconnected from server");
     }
 }
 
 void MainWindow::handleUserJoined(const QString& channel, const QString& user) {
-    if (channelDisplays.contains(channel)) {
-        channelDisplays[channel]->addSystemMessage(
-            QString("%1 has joined %2").arg(user, channel)
-        );
-    }
+    nickIndex.addUser(channel, user);
+    userList->addUser(channel, user);
+    if (session->state()->isSelf(user)) nickIndex.setChannels(session->state()->channelNames());
 }
 
 void MainWindow::handleUserLeft(const QString& channel, const QString& user) {
-    if (channelDisplays.contains(channel)) {
-        channelDisplays[channel]->addSystemMessage(
-            QString("%1 has left %2").arg(user, channel)
-        );
+    userList->removeUser(channel, user);
+
+    // Parting or being kicked drops the whole channel from completion
+    if (session->state()->isSelf(user)) {
+        nickIndex.clearChannel(channel);
+        nickIndex.setChannels(session->state()->channelNames());
+    } else {
+        nickIndex.removeUser(channel, user);
+    }
+}
+
+void MainWindow::handleUserQuit(const QString& user, const QStringList& channels, const QString&) {
+    for (const QString& channel : channels) {
+        nickIndex.removeUser(channel, user);
+        userList->removeUser(channel, user);
     }
 }
 
+void MainWindow::handleNickChanged(const QString& oldNick, const QString& newNick,
+                                   const QStringList& channels) {
+    if (newNick == session->nickname()) nickDisplay->setText(newNick);
+    for (const QString& channel : channels) {
+        nickIndex.removeUser(channel, oldNick);
+        nickIndex.addUser(channel, newNick);
+        userList->refreshChannel(channel);
+    }
+}
+
+void MainWindow::handleNamesReceived(const QString& channel) {
+    nickIndex.setUsers(channel, session->state()->channelNicks(channel));
+    userList->refreshChannel(channel);
+}
+
 void MainWindow::handleTabChanged(int index) {
     if (index >= 0) {
         QString channel = channelTabs->tabText(index);
@@ -5,47 +5,75 @@
 #include <QTabWidget>
 #include <QLabel>
 #include <QTimer>
+#include <QDockWidget>
 #include "widgets/chan_list.h"
 #include "widgets/usr_list.h"
 #include "widgets/msg_display.h"
-#include "../core/client.h"
+#include "widgets/input_line.h"
+#include "widgets/transfer_list.h"
+#include "../core/session.h"
+#include "../core/nick_index.h"
+#include "../core/dcc.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    explicit MainWindow(QWidget* parent = nullptr);
+    explicit MainWindow(Session* session, QWidget* parent = nullptr);
 
 private slots:
     void showConnectDialog();
     void handleConnect();
     void handleDisconnect();
-    void handleMessageReceived(const IrcMessage& message);
+    void handleLineAdded(const ScrollbackLine& line);
     void handleUserJoined(const QString& channel, const QString& user);
     void handleUserLeft(const QString& channel, const QString& user);
+    void handleUserQuit(const QString& user, const QStringList& channels, const QString& reason);
+    void handleNickChanged(const QString& oldNick, const QString& newNick, const QStringList& channels);
+    void handleNamesReceived(const QString& channel);
     void handleChannelChanged(const QString& channel);
     void handleTabChanged(int index);
+    void restoreSession();
     void sendMessage();
+    void sendFile(bool passive);
+    void acceptTransfer(int id);
+    void editIgnoreList();
+    void editHighlights();
+    void setMonospace(bool enabled);
+    void importLogs();
     void about();
 
 private:
-    // Core IRC client
-    IrcClient* ircClient;
+    // In-process client or a link to a running core
+    Session* session;
 
     // UI Components
     QMenuBar* menuBar;
     ChannelList* channelList;
     UserList* userList;
     QTabWidget* channelTabs;
-    QLineEdit* messageInput;
+    InputLine* messageInput;
     QLabel* nickDisplay;
     
+    // DCC transfers
+    DccManager* dccManager;
+    TransferList* transferList;
+    QDockWidget* transferDock;
+    
     // Channel management
     QMap<QString, ChatDisplay*> channelDisplays;
     QString currentChannel;
+    NickIndex nickIndex;
     
     void setupMenuBar();
     void setupLayout();
     void createChannelTab(const QString& channel);
     void removeChannelTab(const QString& channel);
+    ChatDisplay* findDisplay(const QString& buffer) const;
+    ChatDisplay* displayFor(const QString& buffer);
+    void replayHistory(ChatDisplay* display, const QString& buffer);
+    void rebuildTabs();
+    void listHistory();
+    void showLine(ChatDisplay* display, const ScrollbackLine& line);
+    void loadFilterRules();
 };
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "input_line.h"
+#include <QKeyEvent>
+
+InputLine::InputLine(QWidget* parent) : QLineEdit(parent) {
+}
+
+void InputLine::setChannel(const QString& newChannel) {
+    channel = newChannel;
+    resetCompletion();
+}
+
+bool InputLine::event(QEvent* event) {
+    // Tab normally moves focus, so grab it before QWidget does
+    if (event->type() == QEvent::KeyPress) {
+        auto keyEvent = static_cast<QKeyEvent*>(event);
+        if (keyEvent->key() == Qt::Key_Tab && keyEvent->modifiers() == Qt::NoModifier) {
+            completeNick();
+            return true;
+        }
+    }
+    return QLineEdit::event(event);
+}
+
+void InputLine::keyPressEvent(QKeyEvent* event) {
+    resetCompletion();
+    QLineEdit::keyPressEvent(event);
+}
+
+void InputLine::completeNick() {
+    if (!nickIndex) return;
+
+    // Keep cycling through the same candidates if nothing was typed since
+    if (candidateIndex >= 0 && text() == completedText) {
+        candidateIndex = (candidateIndex + 1) % candidates.size();
+    } else {
+        QString line = text();
+        int cursor = cursorPosition();
+        int wordStart = line.lastIndexOf(' ', cursor - 1) + 1;
+        QString prefix = line.mid(wordStart, cursor - wordStart);
+        if (prefix.isEmpty()) return;
+
+        candidates = nickIndex->complete(channel, prefix);
+        if (candidates.isEmpty()) return;
+        candidateIndex = 0;
+        head = line.left(wordStart);
+        tail = line.mid(cursor);
+    }
+
+    QString nick = candidates.at(candidateIndex);
+    bool isChannel = QString("#&+!").contains(nick.at(0));
+    QString suffix = head.isEmpty() && !isChannel ? QStringLiteral(": ") : QStringLiteral(" ");
+    if (tail.startsWith(' ')) suffix.chop(1);
+
+    setText(head + nick + suffix + tail);
+    setCursorPosition(head.size() + nick.size() + suffix.size());
+    completedText = text();
+}
+
+void InputLine::resetCompletion() {
+    candidates.clear();
+    candidateIndex = -1;
+    head.clear();
+    tail.clear();
+    completedText.clear();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <QLineEdit>
+#include <QStringList>
+#include "../../core/nick_index.h"
+
+class InputLine : public QLineEdit {
+    Q_OBJECT
+public:
+    explicit InputLine(QWidget* parent = nullptr);
+
+    void setNickIndex(const NickIndex* index) { nickIndex = index; }
+    void setChannel(const QString& channel);
+
+protected:
+    bool event(QEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+
+private:
+    const NickIndex* nickIndex = nullptr;
+    QString channel;
+
+    // Tab cycling state, reset by any other key
+    QStringList candidates;
+    int candidateIndex = -1;
+    QString head;
+    QString tail;
+    QString completedText;
+
+    void completeNick();
+    void resetCompletion();
+};
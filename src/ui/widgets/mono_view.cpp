@@ -0,0 +1,248 @@
+#include "mono_view.h"
+#include <QEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtMath>
+
+namespace {
+const int Margin = 4;
+}
+
+MonoView::MonoView(QWidget* parent) : QAbstractScrollArea(parent) {
+    lines.setCapacity(10000);
+    rowEnds.setCapacity(10000);
+    layouts.setMaxCost(2048);
+
+    viewport()->setBackgroundRole(QPalette::Base);
+    viewport()->setAutoFillBackground(true);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+
+    QFont mono("Terminus (TTF)");
+    mono.setPixelSize(14);
+    mono.setStyleHint(QFont::TypeWriter);
+    setFont(mono);
+    updateMetrics();
+}
+
+void MonoView::appendLine(const QString& text, const QVector<Span>& spans,
+                          const QColor& background, bool bold) {
+    QScrollBar* bar = verticalScrollBar();
+    bool atBottom = bar->value() >= bar->maximum();
+    int value = bar->value();
+
+    // A full ring drops its oldest line on append
+    qint64 evicted = 0;
+    if (lines.isFull()) {
+        evicted = rowEnds.first() - baseRow;
+        baseRow = rowEnds.first();
+        layouts.remove(lines.firstIndex());
+    }
+
+    Line line;
+    line.text = text;
+    line.spans = spans;
+    line.background = background;
+    line.bold = bold;
+    qint64 end = (rowEnds.isEmpty() ? baseRow : rowEnds.last()) + rowsFor(line);
+    lines.append(line);
+    rowEnds.append(end);
+
+    updateScrollBar();
+    bar->setValue(atBottom ? bar->maximum() : int(value - evicted));
+    viewport()->update();
+}
+
+void MonoView::clear() {
+    lines.clear();
+    rowEnds.clear();
+    baseRow = 0;
+    layouts.clear();
+    updateScrollBar();
+    viewport()->update();
+}
+
+void MonoView::setCapacity(int capacity) {
+    lines.setCapacity(capacity);
+    rowEnds.setCapacity(capacity);
+    updateColumns(true);
+}
+
+void MonoView::paintEvent(QPaintEvent*) {
+    QPainter painter(viewport());
+    if (lines.isEmpty()) return;
+
+    qint64 top = baseRow + verticalScrollBar()->value();
+    int index = lineAtRow(top);
+    qreal y = (rowStart(index) - top) * lineHeight;
+    QColor textColor = palette().color(QPalette::Text);
+    int width = viewport()->width();
+    int height = viewport()->height();
+
+    for (; index <= lines.lastIndex() && y < height; index++) {
+        const Line& line = lines.at(index);
+        int rows = rowsFor(line);
+        if (line.background.isValid()) {
+            painter.fillRect(QRectF(0, y, width, rows * lineHeight), line.background);
+        }
+
+        const Layout* layout = layoutFor(index);
+        for (int i = 0; i < layout->runs.size(); i++) {
+            painter.setPen(layout->colors.at(i).isValid() ? layout->colors.at(i) : textColor);
+            painter.drawGlyphRun(QPointF(Margin, y), layout->runs.at(i));
+        }
+        y += rows * lineHeight;
+    }
+}
+
+void MonoView::resizeEvent(QResizeEvent* event) {
+    QAbstractScrollArea::resizeEvent(event);
+    updateColumns();
+    updateScrollBar();
+}
+
+void MonoView::changeEvent(QEvent* event) {
+    if (event->type() == QEvent::FontChange) updateMetrics();
+    QAbstractScrollArea::changeEvent(event);
+}
+
+void MonoView::updateMetrics() {
+    QFont boldFont = font();
+    boldFont.setBold(true);
+    faces[0] = QRawFont::fromFont(font());
+    faces[1] = QRawFont::fromFont(boldFont);
+
+    for (int face = 0; face < 2; face++) {
+        glyphPages[face] = QVector<QVector<quint32>>(256);
+        QChar question('?');
+        int count = 1;
+        faces[face].glyphIndexesForChars(&question, 1, &missingGlyph[face], &count);
+    }
+
+    // Every cell is as wide as the regular face's 'M'
+    quint32 glyph = glyphFor(0, QChar('M'));
+    QVector<QPointF> advances = faces[0].advancesForGlyphIndexes(QVector<quint32>{glyph});
+    cellWidth = advances.isEmpty() || advances.first().x() <= 0 ? 8 : advances.first().x();
+    ascent = faces[0].ascent();
+    lineHeight = qMax(1, qCeil(faces[0].ascent() + faces[0].descent()));
+
+    updateColumns(true);
+    updateScrollBar();
+    viewport()->update();
+}
+
+void MonoView::updateColumns(bool force) {
+    int fit = qMax(1, int((viewport()->width() - 2 * Margin) / cellWidth));
+    if (fit == columns && !force) return;
+
+    QScrollBar* bar = verticalScrollBar();
+    bool atBottom = bar->value() >= bar->maximum();
+    int topLine = lines.isEmpty() ? 0 : lineAtRow(baseRow + bar->value());
+
+    // Row counts depend on the width only, so re-deriving them is cheap
+    columns = fit;
+    layouts.clear();
+    baseRow = 0;
+    qint64 total = 0;
+    for (int i = lines.firstIndex(); i <= lines.lastIndex(); i++) {
+        total += rowsFor(lines.at(i));
+        rowEnds[i] = total;
+    }
+
+    updateScrollBar();
+    if (atBottom) bar->setValue(bar->maximum());
+    else if (!lines.isEmpty()) bar->setValue(int(rowStart(qMax(topLine, lines.firstIndex()))));
+}
+
+void MonoView::updateScrollBar() {
+    qint64 total = lines.isEmpty() ? 0 : rowEnds.last() - baseRow;
+    int visible = qMax(1, viewport()->height() / lineHeight);
+    QScrollBar* bar = verticalScrollBar();
+    bar->setRange(0, int(qMax<qint64>(0, total - visible)));
+    bar->setPageStep(visible);
+    bar->setSingleStep(1);
+}
+
+int MonoView::rowsFor(const Line& line) const {
+    return qMax(1, (line.text.size() + columns - 1) / columns);
+}
+
+int MonoView::lineAtRow(qint64 row) const {
+    // First line whose running row count goes past row
+    int low = lines.firstIndex();
+    int high = lines.lastIndex();
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (rowEnds.at(mid) > row) high = mid;
+        else low = mid + 1;
+    }
+    return low;
+}
+
+qint64 MonoView::rowStart(int index) const {
+    return index == lines.firstIndex() ? baseRow : rowEnds.at(index - 1);
+}
+
+quint32 MonoView::glyphFor(int face, QChar c) {
+    ushort code = c.unicode();
+    QVector<quint32>& page = glyphPages[face][code >> 8];
+    if (page.isEmpty()) {
+        page.fill(missingGlyph[face], 256);
+        int first = code & 0xff00;
+        // Lone surrogates have no glyph of their own
+        if (!QChar::isSurrogate(first)) {
+            QChar chars[256];
+            for (int i = 0; i < 256; i++) chars[i] = QChar(ushort(first + i));
+            int count = 256;
+            faces[face].glyphIndexesForChars(chars, 256, page.data(), &count);
+            for (quint32& glyph : page) {
+                if (glyph == 0) glyph = missingGlyph[face];
+            }
+        }
+    }
+    return page.at(code & 0xff);
+}
+
+MonoView::Layout* MonoView::layoutFor(int index) {
+    if (Layout* cached = layouts.object(index)) return cached;
+
+    const Line& line = lines.at(index);
+    int face = line.bold ? 1 : 0;
+    auto layout = new Layout;
+    layout->colors << QColor();
+
+    // Which color group each character belongs to
+    QVector<int> group(line.text.size(), 0);
+    for (const Span& span : line.spans) {
+        int slot = layout->colors.indexOf(span.color);
+        if (slot < 0) {
+            slot = layout->colors.size();
+            layout->colors << span.color;
+        }
+        int end = qMin(span.start + span.length, line.text.size());
+        for (int i = qMax(0, span.start); i < end; i++) group[i] = slot;
+    }
+
+    QVector<QVector<quint32>> glyphs(layout->colors.size());
+    QVector<QVector<QPointF>> positions(layout->colors.size());
+    for (int i = 0; i < line.text.size(); i++) {
+        QChar c = line.text.at(i);
+        if (c.isSpace() || c.category() == QChar::Other_Control) continue;
+        glyphs[group[i]] << glyphFor(face, c);
+        positions[group[i]] << QPointF((i % columns) * cellWidth, (i / columns) * lineHeight + ascent);
+    }
+
+    QVector<QColor> colors;
+    for (int g = 0; g < glyphs.size(); g++) {
+        if (glyphs[g].isEmpty()) continue;
+        QGlyphRun run;
+        run.setRawFont(faces[face]);
+        run.setGlyphIndexes(glyphs[g]);
+        run.setPositions(positions[g]);
+        layout->runs << run;
+        colors << layout->colors[g];
+    }
+    layout->colors = colors;
+
+    layouts.insert(index, layout);
+    return layout;
+}
\ No newline at end of file
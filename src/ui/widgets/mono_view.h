@@ -0,0 +1,68 @@
+#pragma once
+#include <QAbstractScrollArea>
+#include <QCache>
+#include <QContiguousCache>
+#include <QGlyphRun>
+#include <QRawFont>
+#include <QVector>
+
+// Plain-text scrollback view for fixed-width fonts. Characters map
+// straight to glyph indexes through a lookup table and every glyph sits
+// on a cell grid, so there is no shaping and wrapping is just division.
+class MonoView : public QAbstractScrollArea {
+    Q_OBJECT
+public:
+    struct Span {
+        int start;
+        int length;
+        QColor color;
+    };
+
+    explicit MonoView(QWidget* parent = nullptr);
+
+    void appendLine(const QString& text, const QVector<Span>& spans = QVector<Span>(),
+                    const QColor& background = QColor(), bool bold = false);
+    void clear();
+    void setCapacity(int lines);
+    int lineCount() const { return lines.count(); }
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void changeEvent(QEvent* event) override;
+
+private:
+    struct Line {
+        QString text;
+        QVector<Span> spans;
+        QColor background;
+        bool bold = false;
+    };
+
+    struct Layout {
+        QVector<QGlyphRun> runs;
+        QVector<QColor> colors;     // invalid means the palette's text color
+    };
+
+    QRawFont faces[2];              // regular, bold
+    QVector<QVector<quint32>> glyphPages[2];  // 256-char pages, filled on first use
+    quint32 missingGlyph[2] = {0, 0};
+    qreal cellWidth = 8;
+    int lineHeight = 16;
+    qreal ascent = 12;
+    int columns = 80;
+
+    QContiguousCache<Line> lines;
+    QContiguousCache<qint64> rowEnds;   // running row count, parallel to lines
+    qint64 baseRow = 0;                 // rows of lines already evicted
+    QCache<int, Layout> layouts;
+
+    void updateMetrics();
+    void updateColumns(bool force = false);
+    void updateScrollBar();
+    int rowsFor(const Line& line) const;
+    int lineAtRow(qint64 row) const;
+    qint64 rowStart(int index) const;
+    quint32 glyphFor(int face, QChar c);
+    Layout* layoutFor(int index);
+};
\ No newline at end of file
@@ -1,34 +1,100 @@
 #include "msg_display.h"
+#include "mono_view.h"
 #include "../../utils/color.h"
+#include <QTextEdit>
+#include <QVBoxLayout>
 
-ChatDisplay::ChatDisplay(QWidget* parent) : QTextEdit(parent) {
-    setReadOnly(true);
+ChatDisplay::Mode ChatDisplay::preferredMode = ChatDisplay::RichText;
+
+ChatDisplay::ChatDisplay(QWidget* parent) : ChatDisplay(preferredMode, parent) {
+}
+
+ChatDisplay::ChatDisplay(Mode mode, QWidget* parent) : QWidget(parent), displayMode(mode) {
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    if (mode == Monospace) {
+        monoView = new MonoView(this);
+        layout->addWidget(monoView);
+    } else {
+        textView = new QTextEdit(this);
+        textView->setReadOnly(true);
+        layout->addWidget(textView);
+    }
+}
+
+QAbstractScrollArea* ChatDisplay::view() const {
+    if (monoView) return monoView;
+    return textView;
 }
 
 void ChatDisplay::addMessage(const QString& sender, const QString& message, 
                            const QDateTime& timestamp) {
+    if (monoView) {
+        addMonoLine(timestamp, "<", sender, "> " + message);
+        return;
+    }
+
     QString timeStr = timestamp.toString("[hh:mm:ss] ");
     QColor userColor = ColorGenerator::generateNickColor(sender);
     QString coloredNick = QString("<span style='color: %1'>%2</span>")
                          .arg(userColor.name(), sender);
     
-    append(QString("%1%2 %3")
+    textView->append(QString("%1%2 %3")
         .arg(timeStr)
         .arg(QString("&lt;%1&gt;").arg(coloredNick))
         .arg(message));
 }
 
+void ChatDisplay::addHighlightedMessage(const QString& sender, const QString& message,
+                                        const QDateTime& timestamp) {
+    if (monoView) {
+        addMonoLine(timestamp, "<", sender, "> " + message, QColor("#FFF3B0"), true);
+        return;
+    }
+
+    QString timeStr = timestamp.toString("[hh:mm:ss] ");
+    QColor userColor = ColorGenerator::generateNickColor(sender);
+    QString coloredNick = QString("<span style='color: %1'>%2</span>")
+                         .arg(userColor.name(), sender);
+
+    textView->append(QString("<span style='background-color: #FFF3B0'>%1&lt;%2&gt; <b>%3</b></span>")
+        .arg(timeStr, coloredNick, message));
+}
+
 void ChatDisplay::addSystemMessage(const QString& message, const QDateTime& timestamp) {
+    if (monoView) {
+        addMonoLine(timestamp, "* " + message, QString(), QString());
+        return;
+    }
+
     QString timeStr = timestamp.toString("[hh:mm:ss] ");
-    append(QString("%1* %2").arg(timeStr, message));
+    textView->append(QString("%1* %2").arg(timeStr, message));
 }
 
 void ChatDisplay::addUserAction(const QString& user, const QString& action,
                               const QDateTime& timestamp) {
+    if (monoView) {
+        addMonoLine(timestamp, "* ", user, " " + action);
+        return;
+    }
+
     QString timeStr = timestamp.toString("[hh:mm:ss] ");
     QColor userColor = ColorGenerator::generateNickColor(user);
     QString coloredNick = QString("<span style='color: %1'>%2</span>")
                          .arg(userColor.name(), user);
     
-    append(QString("%1* %2 %3").arg(timeStr, coloredNick, action));
+    textView->append(QString("%1* %2 %3").arg(timeStr, coloredNick, action));
+}
+
+void ChatDisplay::addMonoLine(const QDateTime& timestamp, const QString& lead, const QString& nick,
+                              const QString& rest, const QColor& background, bool bold) {
+    QString text = timestamp.toString("[hh:mm:ss] ") + lead;
+    QVector<MonoView::Span> spans;
+    if (!nick.isEmpty()) {
+        spans.append({text.size(), nick.size(), ColorGenerator::generateNickColor(nick)});
+        text += nick;
+    }
+    text += rest;
+    monoView->appendLine(text, spans, background, bold);
 }
\ No newline at end of file
@@ -1,16 +1,41 @@
 #pragma once
-#include <QTextEdit>
+#include <QWidget>
 #include <QDateTime>
 
-class ChatDisplay : public QTextEdit {
+class QAbstractScrollArea;
+class QTextEdit;
+class MonoView;
+
+class ChatDisplay : public QWidget {
     Q_OBJECT
 public:
+    // RichText lays lines out through QTextEdit, Monospace draws them on a
+    // fixed cell grid and is much cheaper with long scrollback
+    enum Mode { RichText, Monospace };
+
     explicit ChatDisplay(QWidget* parent = nullptr);
+    explicit ChatDisplay(Mode mode, QWidget* parent = nullptr);
+
+    static void setDefaultMode(Mode mode) { preferredMode = mode; }
+    static Mode defaultMode() { return preferredMode; }
+    Mode mode() const { return displayMode; }
+    QAbstractScrollArea* view() const;
     
     void addMessage(const QString& sender, const QString& message, 
                    const QDateTime& timestamp = QDateTime::currentDateTime());
+    void addHighlightedMessage(const QString& sender, const QString& message,
+                              const QDateTime& timestamp = QDateTime::currentDateTime());
     void addSystemMessage(const QString& message,
                          const QDateTime& timestamp = QDateTime::currentDateTime());
     void addUserAction(const QString& user, const QString& action,
                       const QDateTime& timestamp = QDateTime::currentDateTime());
+
+private:
+    static Mode preferredMode;
+    Mode displayMode;
+    QTextEdit* textView = nullptr;
+    MonoView* monoView = nullptr;
+
+    void addMonoLine(const QDateTime& timestamp, const QString& lead, const QString& nick,
+                     const QString& rest, const QColor& background = QColor(), bool bold = false);
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "transfer_list.h"
+#include <QHeaderView>
+#include <QMenu>
+
+TransferList::TransferList(DccManager* manager, QWidget* parent)
+    : QTreeWidget(parent), manager(manager) {
+    setRootIsDecorated(false);
+    setContextMenuPolicy(Qt::CustomContextMenu);
+    setHeaderLabels({tr("Nick"), tr("File"), tr("Size"), tr("Progress"), tr("Speed"), tr("Status")});
+    header()->setSectionResizeMode(1, QHeaderView::Stretch);
+
+    connect(manager, &DccManager::transferAdded, this, &TransferList::addTransfer);
+    connect(manager, &DccManager::transferUpdated, this, &TransferList::updateTransfer);
+    connect(this, &QTreeWidget::itemActivated, this, &TransferList::handleItemActivated);
+    connect(this, &QWidget::customContextMenuRequested, this, &TransferList::showContextMenu);
+}
+
+void TransferList::addTransfer(int id) {
+    auto item = new QTreeWidgetItem(this);
+    item->setData(0, Qt::UserRole, id);
+    items[id] = item;
+    updateTransfer(id);
+}
+
+void TransferList::updateTransfer(int id) {
+    auto item = items.value(id);
+    auto transfer = manager->transfer(id);
+    if (!item || !transfer) return;
+
+    QString arrow = transfer->direction == DccTransfer::Send ? "-> " : "<- ";
+    int percent = transfer->size > 0 ? int(transfer->transferred * 100 / transfer->size) : 0;
+
+    item->setText(0, arrow + transfer->nick);
+    item->setText(1, transfer->fileName);
+    item->setText(2, formatSize(transfer->size));
+    item->setText(3, QString("%1%").arg(percent));
+    item->setText(4, transfer->rate > 0 ? formatSize(qint64(transfer->rate)) + "/s" : QString());
+    item->setText(5, transfer->statusText());
+}
+
+void TransferList::handleItemActivated(QTreeWidgetItem* item) {
+    int id = item->data(0, Qt::UserRole).toInt();
+    auto transfer = manager->transfer(id);
+    if (transfer && transfer->status == DccTransfer::Offered) {
+        emit acceptRequested(id);
+    }
+}
+
+void TransferList::showContextMenu(const QPoint& pos) {
+    auto item = itemAt(pos);
+    if (!item) return;
+
+    int id = item->data(0, Qt::UserRole).toInt();
+    auto transfer = manager->transfer(id);
+    if (!transfer) return;
+
+    QMenu menu(this);
+    if (transfer->status == DccTransfer::Offered) {
+        menu.addAction(tr("&Accept..."), this, [this, id]() { emit acceptRequested(id); });
+    }
+    if (transfer->status != DccTransfer::Done && transfer->status != DccTransfer::Failed &&
+        transfer->status != DccTransfer::Cancelled) {
+        menu.addAction(tr("&Cancel"), this, [this, id]() { manager->cancel(id); });
+    }
+    if (!menu.isEmpty()) menu.exec(viewport()->mapToGlobal(pos));
+}
+
+QString TransferList::formatSize(qint64 bytes) {
+    if (bytes >= 1024 * 1024 * 1024) return QString::number(bytes / (1024.0 * 1024 * 1024), 'f', 2) + " GiB";
+    if (bytes >= 1024 * 1024) return QString::number(bytes / (1024.0 * 1024), 'f', 1) + " MiB";
+    if (bytes >= 1024) return QString::number(bytes / 1024.0, 'f', 1) + " KiB";
+    return QString::number(bytes) + " B";
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+#include <QTreeWidget>
+#include <QHash>
+#include "../../core/dcc.h"
+
+class TransferList : public QTreeWidget {
+    Q_OBJECT
+public:
+    explicit TransferList(DccManager* manager, QWidget* parent = nullptr);
+
+signals:
+    void acceptRequested(int id);
+
+private slots:
+    void addTransfer(int id);
+    void updateTransfer(int id);
+    void handleItemActivated(QTreeWidgetItem* item);
+    void showContextMenu(const QPoint& pos);
+
+private:
+    DccManager* manager;
+    QHash<int, QTreeWidgetItem*> items;
+
+    static QString formatSize(qint64 bytes);
+};
\ No newline at end of file
@@ -5,33 +5,47 @@ UserList::UserList(QWidget* parent) : QListWidget(parent) {
     setSelectionMode(QAbstractItemView::NoSelection);
 }
 
-void UserList::updateUsers(const QString& channel, const QStringList& users) {
-    channelUsers[channel] = users;
-    if (channel == activeChannel) {
-        clear();
-        for (const auto& user : users) {
-            auto item = new QListWidgetItem(user);
-            item->setForeground(ColorGenerator::generateNickColor(user));
-            addItem(item);
-        }
+void UserList::refreshChannel(const QString& channel) {
+    if (!isActive(channel)) return;
+    clear();
+    if (!ircState) return;
+    for (const auto& user : ircState->channelUsers(channel)) {
+        addUserItem(user);
     }
 }
 
-void UserList::clearChannel(const QString& channel) {
-    channelUsers.remove(channel);
-    if (channel == activeChannel) {
-        clear();
+void UserList::addUser(const QString& channel, const QString& user) {
+    if (isActive(channel)) addUserItem(user);
+}
+
+void UserList::removeUser(const QString& channel, const QString& user) {
+    if (!isActive(channel)) return;
+    for (int i = count() - 1; i >= 0; i--) {
+        if (nickOf(item(i)->text()) == user) {
+            delete takeItem(i);
+            break;
+        }
     }
 }
 
 void UserList::setCurrentChannel(const QString& channel) {
     activeChannel = channel;
-    clear();
-    if (channelUsers.contains(channel)) {
-        for (const auto& user : channelUsers[channel]) {
-            auto item = new QListWidgetItem(user);
-            item->setForeground(ColorGenerator::generateNickColor(user));
-            addItem(item);
-        }
-    }
+    refreshChannel(channel);
+}
+
+bool UserList::isActive(const QString& channel) const {
+    if (!ircState) return channel == activeChannel;
+    return ircState->fold(channel) == ircState->fold(activeChannel);
+}
+
+QString UserList::nickOf(const QString& entry) {
+    // Items may carry a mode prefix such as @ or +
+    if (!entry.isEmpty() && QString("~&@%+").contains(entry.at(0))) return entry.mid(1);
+    return entry;
+}
+
+void UserList::addUserItem(const QString& user) {
+    auto item = new QListWidgetItem(user);
+    item->setForeground(ColorGenerator::generateNickColor(nickOf(user)));
+    addItem(item);
 }
\ No newline at end of file
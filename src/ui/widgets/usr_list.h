@@ -1,17 +1,23 @@
 #pragma once
 #include <QListWidget>
-#include <QMap>
+#include "../../core/state.h"
 
 class UserList : public QListWidget {
     Q_OBJECT
 public:
     explicit UserList(QWidget* parent = nullptr);
     
-    void updateUsers(const QString& channel, const QStringList& users);
-    void clearChannel(const QString& channel);
+    void setState(const IrcState* state) { ircState = state; }
+    void refreshChannel(const QString& channel);
+    void addUser(const QString& channel, const QString& user);
+    void removeUser(const QString& channel, const QString& user);
     void setCurrentChannel(const QString& channel);
 
 private:
-    QMap<QString, QStringList> channelUsers;
+    const IrcState* ircState = nullptr;
     QString activeChannel;
+
+    bool isActive(const QString& channel) const;
+    void addUserItem(const QString& user);
+    static QString nickOf(const QString& entry);
 };
\ No newline at end of file